@@ -0,0 +1,184 @@
+#pragma once
+
+#include <tiniestfsm.h>
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// All implementations run the same machine with N states, numbered 0..N-1, and a single event Step{r}.
+// In state i, Step moves to state next_state(i, r) and adds i to an accumulator.
+// With a predictable stream (r always odd) the machine cycles through all states in order.
+// With a random stream the sequence of states is pseudo-random.
+
+namespace bench {
+
+    struct Step { unsigned r; };
+
+    template <size_t N>
+    constexpr size_t next_state(size_t i, unsigned r)
+    {
+        return (r & 1) ? (i + 1) % N : (i * 5 + 3) % N;
+    }
+
+    enum class Stream { Predictable, Random };
+
+    inline const std::vector<Step>& events(Stream stream)
+    {
+        static const std::vector<Step> predictable(4096, Step{ 1 });
+        static const std::vector<Step> random = [] {
+            std::mt19937 gen(12345);
+            std::vector<Step> res(4096);
+            for (auto& ev : res)
+                ev.r = unsigned(gen());
+            return res;
+        }();
+        return stream == Stream::Predictable ? predictable : random;
+    }
+
+    template <typename F>
+    void run(benchmark::State& state, Stream stream, F&& f)
+    {
+        const auto& evs = events(stream);
+        for (auto _ : state)
+            for (const Step& ev : evs)
+                f(ev);
+        state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(evs.size()));
+    }
+
+    // *****************************
+    // tiniest_fsm
+    //
+
+    template <size_t N, size_t I>
+    struct TiniestState
+    {
+        static void handle(auto* fsm, const Step& ev)
+        {
+            fsm->acc += unsigned(I);
+            if (ev.r & 1)
+                fsm->template enterState<TiniestState<N, next_state<N>(I, 1)>>();
+            else
+                fsm->template enterState<TiniestState<N, next_state<N>(I, 0)>>();
+        }
+    };
+
+    template <size_t N, typename Is = std::make_index_sequence<N>>
+    struct tiniest_states;
+
+    template <size_t N, size_t...Is>
+    struct tiniest_states<N, std::index_sequence<Is...>> { using type = std::tuple<TiniestState<N, Is>...>; };
+
+    // Policy is the option DispatchPolicy of the state machine
+    template <size_t N, typename Policy = tiniest_fsm::AutoDispatch>
+    struct TiniestFsm : tiniest_fsm::StateMachine<TiniestFsm<N, Policy>, typename tiniest_states<N>::type, tiniest_fsm::DispatchPolicy<Policy>>
+    {
+        unsigned acc = 0;
+    };
+
+    // *****************************
+    // hand written switch
+    //
+
+#define BENCH_CASES_4(n, X) X(n) X(n + 1) X(n + 2) X(n + 3)
+#define BENCH_CASES_16(n, X) BENCH_CASES_4(n, X) BENCH_CASES_4(n + 4, X) BENCH_CASES_4(n + 8, X) BENCH_CASES_4(n + 12, X)
+#define BENCH_CASES_64(n, X) BENCH_CASES_16(n, X) BENCH_CASES_16(n + 16, X) BENCH_CASES_16(n + 32, X) BENCH_CASES_16(n + 48, X)
+#define BENCH_CASES_256(n, X) BENCH_CASES_64(n, X) BENCH_CASES_64(n + 64, X) BENCH_CASES_64(n + 128, X) BENCH_CASES_64(n + 192, X)
+#define BENCH_CASES_1024(n, X) BENCH_CASES_256(n, X) BENCH_CASES_256(n + 256, X) BENCH_CASES_256(n + 512, X) BENCH_CASES_256(n + 768, X)
+#define BENCH_CASES_4096(n, X) BENCH_CASES_1024(n, X) BENCH_CASES_1024(n + 1024, X) BENCH_CASES_1024(n + 2048, X) BENCH_CASES_1024(n + 3072, X)
+
+#define BENCH_CASE(n)                                        \
+    case (n):                                                \
+        if constexpr ((n) < N) {                             \
+            acc += unsigned(n);                              \
+            state = unsigned(next_state<N>((n), ev.r & 1));  \
+            break;                                           \
+        }                                                    \
+        [[fallthrough]];
+
+    template <size_t N>
+    struct SwitchFsm
+    {
+        static_assert(N <= 4096);
+
+        unsigned state = 0;
+        unsigned acc = 0;
+
+        void process(const Step& ev)
+        {
+            switch (state) {
+                BENCH_CASES_4096(0, BENCH_CASE)
+            default:
+                __builtin_unreachable();
+            }
+        }
+    };
+
+#undef BENCH_CASE
+
+    // *****************************
+    // table of function pointers
+    //
+
+    template <size_t N>
+    struct TableFsm
+    {
+        using fun_t = unsigned (*)(unsigned& acc, unsigned r);
+
+        template <size_t I>
+        static unsigned handle(unsigned& acc, unsigned r)
+        {
+            acc += unsigned(I);
+            return unsigned(next_state<N>(I, r & 1));
+        }
+
+        static constexpr auto s_table = []<size_t...Is>(std::index_sequence<Is...>) {
+            return std::array<fun_t, N>{ &handle<Is>... };
+        }(std::make_index_sequence<N>{});
+
+        unsigned state = 0;
+        unsigned acc = 0;
+
+        void process(const Step& ev)
+        {
+            state = s_table[state](acc, ev.r);
+        }
+    };
+
+    // *****************************
+    // std::variant and std::visit
+    //
+
+    template <size_t I>
+    struct VariantState {};
+
+    template <size_t N, typename Is = std::make_index_sequence<N>>
+    struct variant_states;
+
+    template <size_t N, size_t...Is>
+    struct variant_states<N, std::index_sequence<Is...>> { using type = std::variant<VariantState<Is>...>; };
+
+    template <size_t N>
+    struct VariantFsm
+    {
+        using variant_t = typename variant_states<N>::type;
+
+        variant_t state;
+        unsigned acc = 0;
+
+        void process(const Step& ev)
+        {
+            std::visit([&]<size_t I>(VariantState<I>) {
+                acc += unsigned(I);
+                if (ev.r & 1)
+                    state.template emplace<next_state<N>(I, 1)>();
+                else
+                    state.template emplace<next_state<N>(I, 0)>();
+            }, state);
+        }
+    };
+
+} // namespace bench
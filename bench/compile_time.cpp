@@ -0,0 +1,66 @@
+// Compiled once for each number of states, with -DCT_STATES=N, to measure the time and memory taken by the
+// compiler to instantiate a StateMachine (see the target compile-time in the Makefile).
+// Nothing is run: the object file only needs to contain the instantiated process functions.
+
+#include <tiniestfsm.h>
+
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+#ifndef CT_STATES
+#error "CT_STATES must be defined"
+#endif
+
+namespace {
+
+    constexpr size_t N = CT_STATES;
+
+    // handled by all states, each moving to the next one
+    struct Step { unsigned r; };
+
+    // handled by every eighth state, so that it is dispatched through the table or switch of a sparse event
+    struct Reset {};
+
+    // handled by no state
+    struct Ignored {};
+
+    template <size_t I>
+    struct State
+    {
+        static void handle(auto* fsm, const Step& ev)
+        {
+            fsm->acc += ev.r;
+            fsm->template enterState<State<(I + 1) % N>>();
+        }
+
+        static void handle(auto* fsm, const Reset&) requires (I % 8 == 0)
+        {
+            fsm->template enterState<State<0>>();
+        }
+    };
+
+    template <typename Is = std::make_index_sequence<N>>
+    struct states;
+
+    template <size_t...Is>
+    struct states<std::index_sequence<Is...>> { using type = std::tuple<State<Is>...>; };
+
+    struct Fsm : tiniest_fsm::StateMachine<Fsm, typename states<>::type>
+    {
+        unsigned acc = 0;
+    };
+
+} // namespace
+
+unsigned run(const Step* steps, size_t n)
+{
+    Fsm fsm;
+    for (size_t i = 0; i < n; ++i) {
+        fsm.process(steps[i]);
+        fsm.process(Ignored{});
+        if (steps[i].r == 0)
+            fsm.process(Reset{});
+    }
+    return fsm.acc;
+}
@@ -0,0 +1,60 @@
+// Compiled once for each number of states, with -DBENCH_STATES=N
+
+#include "bench.h"
+
+#ifndef BENCH_STATES
+#error "BENCH_STATES must be defined"
+#endif
+
+namespace {
+
+    using namespace bench;
+
+    constexpr size_t N = BENCH_STATES;
+
+    // above this number of states, std::variant is too expensive to compile
+    constexpr size_t s_maxVariantStates = 256;
+
+    // above this number of states, a chain of comparisons is too slow to be worth measuring
+    constexpr size_t s_maxIfChainStates = 64;
+
+    template <typename FSM>
+    void benchFsm(benchmark::State& state, Stream stream)
+    {
+        FSM fsm{};
+        if constexpr (requires { fsm.template enterState<TiniestState<N, 0>>(); })
+            fsm.template enterState<TiniestState<N, 0>>();
+        run(state, stream, [&](const Step& ev) { fsm.process(ev); });
+        benchmark::DoNotOptimize(fsm.acc);
+    }
+
+    template <typename FSM>
+    void registerFsm(const char* name)
+    {
+        const std::string prefix = std::string(name) + "/" + std::to_string(N) + "/";
+        benchmark::RegisterBenchmark((prefix + "predictable").c_str(), benchFsm<FSM>, Stream::Predictable);
+        benchmark::RegisterBenchmark((prefix + "random").c_str(), benchFsm<FSM>, Stream::Random);
+    }
+
+    template <size_t M>
+    bool registerAll()
+    {
+        registerFsm<TiniestFsm<M>>("tiniest");
+        if constexpr (M <= 256) {
+            registerFsm<TiniestFsm<M, tiniest_fsm::SwitchDispatch>>("tiniest-switch");
+            registerFsm<TiniestFsm<M, tiniest_fsm::ComputedGotoDispatch>>("tiniest-goto");
+        }
+        registerFsm<TiniestFsm<M, tiniest_fsm::JumpTableDispatch>>("tiniest-jumptable");
+        if constexpr (M <= s_maxIfChainStates)
+            registerFsm<TiniestFsm<M, tiniest_fsm::IfChainDispatch>>("tiniest-ifchain");
+        registerFsm<TiniestFsm<M, tiniest_fsm::BinarySearchDispatch>>("tiniest-bsearch");
+        registerFsm<SwitchFsm<M>>("switch");
+        registerFsm<TableFsm<M>>("table");
+        if constexpr (M <= s_maxVariantStates)
+            registerFsm<VariantFsm<M>>("variant");
+        return true;
+    }
+
+    const bool s_registered = registerAll<N>();
+
+} // namespace
@@ -0,0 +1,98 @@
+#include <tiniestfsm.h>
+
+#include <iostream>
+
+// checks state machines with orthogonal regions against a plain model, both with at most 256 combinations of states
+// (a single switch on the packed id) and with more (a switch per region)
+
+struct StepEvent {};
+struct CrossEvent {};
+
+template <unsigned NA, unsigned NB>
+struct Model
+{
+    // region A: on StepEvent moves to the next state; on CrossEvent enters the state of B with the same index
+    template <unsigned I>
+    struct A
+    {
+        static void handle(auto* fsm, const StepEvent&)
+        {
+            fsm->template enterState<A<(I + 1) % NA>>();
+        }
+
+        static void handle(auto* fsm, const CrossEvent&)
+        {
+            fsm->template enterState<typename Model::template B<I % NB>>();
+        }
+    };
+
+    // region B: on StepEvent, only even states move forward by 3; on CrossEvent enters the state of A with the same index
+    template <unsigned J>
+    struct B
+    {
+        static void handle(auto* fsm, const StepEvent&) requires (J % 2 == 0)
+        {
+            fsm->template enterState<B<(J + 3) % NB>>();
+        }
+
+        static void handle(auto* fsm, const CrossEvent&)
+        {
+            fsm->template enterState<typename Model::template A<J % NA>>();
+        }
+    };
+
+    template <typename IA = std::make_integer_sequence<unsigned, NA>, typename IB = std::make_integer_sequence<unsigned, NB>>
+    struct regions;
+
+    template <unsigned...Is, unsigned...Js>
+    struct regions<std::integer_sequence<unsigned, Is...>, std::integer_sequence<unsigned, Js...>>
+    {
+        using type = tiniest_fsm::Regions<std::tuple<A<Is>...>, std::tuple<B<Js>...>>;
+    };
+
+    struct Fsm : tiniest_fsm::StateMachine<Fsm, typename regions<>::type> {};
+
+    // runs a sequence of events through the state machine and through the plain model, and compares the states
+    static bool run()
+    {
+        Fsm fsm;
+        unsigned a = 0, b = 0;
+        bool ok = true;
+        for (unsigned i = 0; i < 1000; ++i) {
+            if (i % 7 == 3) {
+                // both regions handle the event in the states which were current when it was processed
+                fsm.process(CrossEvent{});
+                const unsigned a0 = a;
+                a = b % NA;
+                b = a0 % NB;
+            }
+            else {
+                fsm.process(StepEvent{});
+                a = (a + 1) % NA;
+                if (b % 2 == 0)
+                    b = (b + 3) % NB;
+            }
+            if (i % 101 == 100) {
+                fsm.template enterState<B<1>>();
+                b = 1;
+            }
+            ok = ok && fsm.template currentStateId<0>() == a && fsm.template currentStateId<1>() == b
+                && fsm.currentStateId() == a + NA * b && fsm.template inState<A<0>>() == (a == 0);
+        }
+        return ok;
+    }
+};
+
+bool check(bool ok, const char* what)
+{
+    std::cout << what << ": " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    ok &= check(Model<4, 5>::run(), "4 x 5 states, single switch");
+    ok &= check(Model<17, 17>::run(), "17 x 17 states, switch per region");
+    return ok ? 0 : 1;
+}
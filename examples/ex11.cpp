@@ -0,0 +1,120 @@
+#include <tiniestfsm_snapshot.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+// checks that a pool written with writeSnapshot and mapped back with MappedPoolStorage has the same instances,
+// also for over-aligned state machines (whose padding is larger than a cache line), and that changes to the mapped
+// pool survive reopening the file
+
+struct TickEvent { unsigned n; };
+struct ResetEvent {};
+
+struct Running;
+
+struct Stopped
+{
+    static void handle(auto* fsm, const TickEvent& ev)
+    {
+        fsm->ticks += ev.n;
+        fsm->template enterState<Running>();
+    }
+};
+
+struct Running
+{
+    static void handle(auto* fsm, const TickEvent& ev)
+    {
+        fsm->ticks += ev.n;
+    }
+
+    static void handle(auto* fsm, const ResetEvent&)
+    {
+        fsm->template enterState<Stopped>();
+    }
+};
+
+template <size_t Align>
+struct alignas(Align) Timer : tiniest_fsm::StateMachine<Timer<Align>, std::tuple<Stopped, Running>>
+{
+    unsigned ticks = 0;
+};
+
+bool check(bool ok, const std::string& what)
+{
+    std::cout << what << ": " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+template <typename P1, typename P2>
+bool samePools(const P1& a, const P2& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a.currentStateId(i) != b.currentStateId(i) || a[i].ticks != b[i].ticks || a[i].currentStateId() != b.currentStateId(i))
+            return false;
+    return true;
+}
+
+template <size_t Align>
+bool roundTrip(const std::string& path)
+{
+    using timer_t = Timer<Align>;
+    constexpr size_t n = 37;
+
+    tiniest_fsm::StateMachinePool<timer_t> pool;
+    for (size_t i = 0; i < n; ++i)
+        pool.template emplace<Stopped>();
+    for (size_t i = 0; i < n; i += 3)
+        pool.process(i, TickEvent{ unsigned(i) });
+    pool.broadcast(TickEvent{ 1 });
+    for (size_t i = 0; i < n; i += 5)
+        pool.process(i, ResetEvent{});
+
+    std::remove(path.c_str());
+    tiniest_fsm::writeSnapshot(pool, path.c_str());
+    bool ok = true;
+    {
+        tiniest_fsm::StateMachinePool<timer_t, tiniest_fsm::MappedPoolStorage> mapped(path.c_str(), 0);
+        ok = ok && samePools(pool, mapped);
+
+        // the same changes in both pools, then the mapped one is flushed and reopened
+        pool.broadcast(ResetEvent{});
+        mapped.broadcast(ResetEvent{});
+        pool.process(7, TickEvent{ 100 });
+        mapped.process(7, TickEvent{ 100 });
+        mapped.storage().flush();
+    }
+    tiniest_fsm::StateMachinePool<timer_t, tiniest_fsm::MappedPoolStorage> reopened(path.c_str(), 0);
+    ok = ok && samePools(pool, reopened);
+    std::remove(path.c_str());
+    return ok;
+}
+
+int main()
+{
+    const std::string path = (std::filesystem::temp_directory_path() / "tiniestfsm_ex11.snapshot").string();
+    bool ok = true;
+    ok &= check(roundTrip<alignof(unsigned)>(path), "snapshot round trip");
+    ok &= check(roundTrip<256>(path), "snapshot round trip, over-aligned state machine");
+
+    // a snapshot is rejected by a pool of a different state machine
+    {
+        tiniest_fsm::StateMachinePool<Timer<4>> pool;
+        pool.emplace<Stopped>();
+        tiniest_fsm::writeSnapshot(pool, path.c_str());
+        bool rejected = false;
+        try {
+            tiniest_fsm::StateMachinePool<Timer<256>, tiniest_fsm::MappedPoolStorage> mapped(path.c_str(), 0);
+        }
+        catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        ok &= check(rejected, "snapshot of a different state machine rejected");
+        std::remove(path.c_str());
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+#include <tiniestfsm_pool.h>
+#include <tiniestfsm_timer.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+// checks TimerWheel against a plain model (a map of expiry times) with timeouts cascaded across all levels,
+// that advancing over a long idle period does not step through every tick, and that the timeouts of states are armed
+// on entry and cancelled on exit, for a single state machine and for a pool
+
+bool check(bool ok, const char* what)
+{
+    std::cout << what << ": " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+// random arms, cancels and advances, with timeouts from a few ticks to more than 2^32
+bool model()
+{
+    constexpr uint32_t nTimers = 64;
+    std::mt19937_64 rng(42);
+    tiniest_fsm::TimerWheel wheel(1000);
+    std::map<uint32_t, uint64_t> running;  // timer -> expiry
+    bool ok = true;
+
+    auto randomTicks = [&] {
+        switch (rng() % 5) {
+        case 0: return 1 + rng() % 300;                      // level 0 and 1
+        case 1: return 1 + rng() % 100000;                   // level 1 and 2
+        case 2: return 1 + rng() % (uint64_t(1) << 26);      // level 2 and 3
+        case 3: return 1 + rng() % (uint64_t(1) << 34);      // cascaded more than once
+        default: return 1 + rng() % 10;
+        }
+    };
+
+    for (unsigned step = 0; step < 20000; ++step) {
+        const uint32_t timer = uint32_t(rng() % nTimers);
+        switch (rng() % 4) {
+        case 0:
+        case 1: {
+            const uint64_t ticks = randomTicks();
+            wheel.arm(timer, ticks, timer);
+            running[timer] = wheel.now() + ticks;
+            break;
+        }
+        case 2:
+            wheel.cancel(timer);
+            running.erase(timer);
+            break;
+        default: {
+            const uint64_t now = wheel.now() + randomTicks() / (rng() % 2 ? 1 : 1000);
+            std::vector<std::pair<uint64_t, uint32_t>> expected;
+            for (const auto& [t, expiry] : running)
+                if (expiry <= now)
+                    expected.emplace_back(expiry, t);
+            std::sort(expected.begin(), expected.end());
+            std::vector<std::pair<uint64_t, uint32_t>> expired;
+            wheel.advance(now, [&](uint32_t t, const tiniest_fsm::TimeoutEvent& ev) {
+                ok = ok && ev.state == t && running.contains(t);
+                expired.emplace_back(running[t], t);
+            });
+            // in order of expiry, in any order for the same expiry
+            ok = ok && std::is_sorted(expired.begin(), expired.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            std::sort(expired.begin(), expired.end());
+            ok = ok && expired == expected && wheel.now() == now;
+            for (const auto& [expiry, t] : expired)
+                running.erase(t);
+            break;
+        }
+        }
+        ok = ok && wheel.size() == running.size();
+        for (uint32_t t = 0; t < nTimers; ++t)
+            ok = ok && wheel.running(t) == running.contains(t);
+    }
+    return ok;
+}
+
+// a single timer of 2^40 ticks: stepping one tick at a time would never finish
+bool longIdle()
+{
+    tiniest_fsm::TimerWheel wheel;
+    const uint64_t ticks = uint64_t(1) << 40;
+    wheel.arm(0, ticks, 0);
+    size_t n = wheel.advance(ticks - 1, [](uint32_t, const tiniest_fsm::TimeoutEvent&) {});
+    n += wheel.advance(ticks + 5, [](uint32_t, const tiniest_fsm::TimeoutEvent&) {});
+    return n == 1 && wheel.size() == 0 && wheel.now() == ticks + 5;
+}
+
+struct ConnectEvent {};
+struct ConnectedEvent {};
+struct DisconnectEvent {};
+
+struct Idle;
+struct Connected;
+struct Failed;
+
+struct Connecting
+{
+    static constexpr uint64_t timeout = 500;
+
+    static void handle(auto* session, const ConnectedEvent&) { session->template enterState<Connected>(); }
+    static void handle(auto* session, const DisconnectEvent&) { session->template enterState<Idle>(); }
+    static void handle(auto* session, const tiniest_fsm::TimeoutEvent&) { session->template enterState<Failed>(); }
+};
+
+// an idle connection is closed after 70000 ticks, a timeout which is cascaded from level 2
+struct Connected
+{
+    static constexpr uint64_t timeout = 70000;
+
+    static void handle(auto* session, const DisconnectEvent&) { session->template enterState<Idle>(); }
+    static void handle(auto* session, const tiniest_fsm::TimeoutEvent&)
+    {
+        ++session->idleTimeouts;
+        session->template enterState<Idle>();
+    }
+};
+
+struct Idle
+{
+    static void handle(auto* session, const ConnectEvent&) { session->template enterState<Connecting>(); }
+};
+
+struct Failed
+{
+    static void handle(auto* session, const ConnectEvent&) { session->template enterState<Connecting>(); }
+};
+
+struct Session : tiniest_fsm::StateMachine<Session, std::tuple<Idle, Connecting, Connected, Failed>,
+                                           tiniest_fsm::Timeouts<tiniest_fsm::TimerWheel>>
+{
+    unsigned idleTimeouts = 0;
+};
+
+bool session()
+{
+    tiniest_fsm::TimerWheel wheel;
+    Session session;
+    session.attachTimer(wheel, 0);
+    auto advance = [&](uint64_t now) {
+        return wheel.advance(now, [&](uint32_t, const tiniest_fsm::TimeoutEvent& ev) { session.process(ev); });
+    };
+
+    bool ok = wheel.size() == 0;  // Idle has no timeout
+
+    // armed on entry, expires
+    session.process(ConnectEvent{});
+    ok = ok && wheel.running(0) && advance(499) == 0 && advance(500) == 1 && session.inState<Failed>() && wheel.size() == 0;
+
+    // cancelled on exit
+    session.process(ConnectEvent{});
+    advance(900);
+    session.process(DisconnectEvent{});
+    ok = ok && session.inState<Idle>() && wheel.size() == 0 && advance(10000) == 0 && session.inState<Idle>();
+
+    // re-armed by the transition to another state with a timeout, and cascaded from level 2 down to level 0
+    session.process(ConnectEvent{});
+    advance(10400);
+    session.process(ConnectedEvent{});
+    ok = ok && wheel.running(0) && advance(10400 + 69999) == 0 && session.inState<Connected>()
+        && advance(10400 + 70000) == 1 && session.inState<Idle>() && session.idleTimeouts == 1 && wheel.size() == 0;
+
+    session.detachTimer();
+    return ok;
+}
+
+// sessions connecting at different times, in a pool, some of them connected before their timeout
+bool pool()
+{
+    constexpr size_t n = 1000;
+    tiniest_fsm::TimerWheel wheel;
+    tiniest_fsm::StateMachinePool<Session> sessions;
+    for (size_t i = 0; i < n; ++i)
+        sessions.emplace<Idle>();
+    tiniest_fsm::attachTimers(sessions, wheel);
+
+    bool ok = true;
+    for (uint64_t now = 0; now < n; ++now) {
+        wheel.expire(now, sessions);
+        sessions.process(now, ConnectEvent{});
+        if (now % 3 == 0)
+            sessions.process(now / 2, ConnectedEvent{});
+    }
+    wheel.expire(200000, sessions);
+
+    // each session either failed 500 ticks after connecting, or was closed 70000 ticks after it connected:
+    // session i connects at time i, and receives ConnectedEvent at time 2i or 2i + 1, if a multiple of 3
+    for (size_t i = 0; i < n; ++i) {
+        bool connected = false;
+        for (size_t t = 2 * i; t <= 2 * i + 1; ++t)
+            connected = connected || (t < n && t % 3 == 0 && t < i + Connecting::timeout);
+        ok = ok && (connected ? sessions.currentStateId(i) == 0 && sessions[i].idleTimeouts == 1
+                              : sessions.currentStateId(i) == 3 && sessions[i].idleTimeouts == 0);
+    }
+    return ok && wheel.size() == 0;
+}
+
+int main()
+{
+    bool ok = true;
+    ok &= check(model(), "timer wheel matches the plain model");
+    ok &= check(longIdle(), "advance skips idle ticks");
+    ok &= check(session(), "timeouts armed on entry and cancelled on exit");
+    ok &= check(pool(), "timeouts of a pool");
+    return ok ? 0 : 1;
+}
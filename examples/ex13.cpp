@@ -0,0 +1,172 @@
+#include <tiniestfsm_dfa.h>
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// checks that ByteDfa gives the same final states as a plain model, whichever way the input is scanned: at once
+// (with SSSE3 or NEON, inputs of 64 bytes or more are scanned with shuffles, see the Makefile), byte by byte,
+// in constant expressions, and as a batch of independent inputs. Automata with up to 16 states use the shuffles,
+// larger ones the table.
+
+using tiniest_fsm::On;
+using tiniest_fsm::CharRange;
+using tiniest_fsm::CharSet;
+using tiniest_fsm::AnyChar;
+
+// a decimal number with optional sign, fraction and exponent, e.g. -12.5e+3
+namespace number {
+
+    struct Sign; struct Int; struct Dot; struct Frac; struct Exp; struct ExpSign; struct ExpInt; struct Bad {};
+
+    using digit = CharRange<'0', '9'>;
+
+    struct Start { using on = std::tuple<On<digit, Int>, On<CharSet<'+', '-'>, Sign>, On<AnyChar, Bad>>; };
+    struct Sign { using on = std::tuple<On<digit, Int>, On<AnyChar, Bad>>; };
+    struct Int { using on = std::tuple<On<digit, Int>, On<CharSet<'.'>, Dot>, On<CharSet<'e', 'E'>, Exp>, On<AnyChar, Bad>>; };
+    struct Dot { using on = std::tuple<On<digit, Frac>, On<AnyChar, Bad>>; };
+    struct Frac { using on = std::tuple<On<digit, Frac>, On<CharSet<'e', 'E'>, Exp>, On<AnyChar, Bad>>; };
+    struct Exp { using on = std::tuple<On<digit, ExpInt>, On<CharSet<'+', '-'>, ExpSign>, On<AnyChar, Bad>>; };
+    struct ExpSign { using on = std::tuple<On<digit, ExpInt>, On<AnyChar, Bad>>; };
+    struct ExpInt { using on = std::tuple<On<digit, ExpInt>, On<AnyChar, Bad>>; };
+
+    using dfa_t = tiniest_fsm::ByteDfa<std::tuple<Start, Sign, Int, Dot, Frac, Exp, ExpSign, ExpInt, Bad>>;
+
+    enum : unsigned { start, sign, integer, dot, frac, exp, expSign, expInt, bad };
+
+    // the same automaton, as a switch
+    unsigned next(unsigned state, unsigned char c)
+    {
+        const bool digit = c >= '0' && c <= '9';
+        switch (state) {
+        case start: return digit ? integer : c == '+' || c == '-' ? sign : bad;
+        case sign: return digit ? integer : bad;
+        case integer: return digit ? integer : c == '.' ? dot : c == 'e' || c == 'E' ? exp : bad;
+        case dot: return digit ? frac : bad;
+        case frac: return digit ? frac : c == 'e' || c == 'E' ? exp : bad;
+        case exp: return digit ? expInt : c == '+' || c == '-' ? expSign : bad;
+        case expSign: return digit ? expInt : bad;
+        case expInt: return digit ? expInt : bad;
+        default: return bad;
+        }
+    }
+
+    const std::string alphabet = "0123456789+-.eEx ";
+
+    static_assert(dfa_t{}.scan("-12.5e+3") == dfa_t::stateIndex<ExpInt>());
+
+} // namespace number
+
+// counts the bytes 'a' modulo N, is reset by 'r', and ignores any other byte (which has no transition)
+namespace counter {
+
+    template <unsigned N>
+    struct Model
+    {
+        template <unsigned I>
+        struct Count { using on = std::tuple<On<CharSet<'a'>, Count<(I + 1) % N>>, On<CharSet<'r'>, Count<0>>>; };
+
+        template <typename Is = std::make_integer_sequence<unsigned, N>>
+        struct dfa;
+
+        template <unsigned...Is>
+        struct dfa<std::integer_sequence<unsigned, Is...>> { using type = tiniest_fsm::ByteDfa<std::tuple<Count<Is>...>>; };
+
+        using dfa_t = typename dfa<>::type;
+
+        static unsigned next(unsigned state, unsigned char c)
+        {
+            return c == 'a' ? (state + 1) % N : c == 'r' ? 0 : state;
+        }
+
+        static inline const std::string alphabet = "aaaarbc\xff";
+    };
+
+} // namespace counter
+
+bool check(bool ok, const std::string& what)
+{
+    std::cout << what << ": " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+// scans random inputs with ByteDfa in all the ways, and compares the final states with the model
+template <typename Dfa, typename Next>
+bool agree(Next next, const std::string& alphabet, unsigned nStates)
+{
+    std::mt19937 rng(7);
+    bool ok = true;
+
+    // lengths on both sides of the threshold of the SIMD path, and not multiples of the number of chunks
+    std::vector<std::string> inputs;
+    for (size_t n = 0; n < 300; ++n) {
+        std::string s(n, ' ');
+        for (char& c : s)
+            c = rng() % 8 == 0 ? char(rng() % 256) : alphabet[rng() % alphabet.size()];
+        inputs.push_back(std::move(s));
+    }
+    std::string all;
+    for (unsigned c = 0; c < 256; ++c)
+        all += char(c) + alphabet;
+    inputs.push_back(all);
+
+    auto model = [&](unsigned state, std::string_view s) {
+        for (const char c : s)
+            state = next(state, (unsigned char)c);
+        return state;
+    };
+
+    std::vector<std::string_view> views;
+    std::vector<typename Dfa::state_id_t> initial, final(inputs.size());
+    for (const std::string& s : inputs) {
+        const unsigned expected = model(0, s);
+
+        Dfa whole;
+        ok = ok && whole.scan(s) == expected && whole.currentStateId() == expected;
+
+        // the table, one byte at a time
+        Dfa bytes;
+        for (const char& c : s)
+            bytes.scan(std::string_view(&c, 1));
+        ok = ok && bytes.currentStateId() == expected;
+
+        // consecutive fragments, some long enough for the SIMD path, which then starts from any state
+        Dfa fragments;
+        for (size_t i = 0; i < s.size();) {
+            const size_t n = std::min(s.size() - i, size_t(rng() % 2 ? rng() % 8 : 64 + rng() % 100));
+            fragments.scan(std::string_view(s).substr(i, n));
+            i += n;
+        }
+        ok = ok && fragments.currentStateId() == expected;
+
+        views.push_back(s);
+        initial.push_back(typename Dfa::state_id_t(rng() % nStates));
+    }
+
+    // the static overload, from any initial state
+    Dfa::scan(views, initial, final);
+    for (size_t i = 0; i < inputs.size(); ++i)
+        ok = ok && final[i] == model(initial[i], views[i]);
+    return ok;
+}
+
+// the same input of more than 64 bytes, scanned in a constant expression (always with the table) and at run time
+constexpr std::string_view s_longNumber = "-1234567890123456789012345678901234567890.1234567890123456789012345678901234567890e+12";
+constexpr unsigned s_longNumberState = number::dfa_t{}.scan(s_longNumber);
+static_assert(s_longNumberState == number::dfa_t::stateIndex<number::ExpInt>());
+
+int main()
+{
+#if defined(__SSSE3__) || (defined(__ARM_NEON) && defined(__aarch64__))
+    const std::string path = "shuffles";
+#else
+    const std::string path = "table only";
+#endif
+    bool ok = true;
+    ok &= check(agree<number::dfa_t>(number::next, number::alphabet, 9), "number, 9 states (" + path + ")");
+    ok &= check(agree<counter::Model<16>::dfa_t>(counter::Model<16>::next, counter::Model<16>::alphabet, 16), "counter, 16 states (" + path + ")");
+    ok &= check(agree<counter::Model<20>::dfa_t>(counter::Model<20>::next, counter::Model<20>::alphabet, 20), "counter, 20 states (table)");
+    ok &= check(number::dfa_t{}.scan(s_longNumber) == s_longNumberState, "constant expression and run time agree");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+#include <tiniestfsm_reflect.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// checks the compile time reflection of a state machine against the state machine itself: the states which handle
+// each event against processRaw, the live states against a plain search of the graph of transitions and targets,
+// and that dead states (pruned by ReachableFrom) are not dispatched; then checks the DOT diagram
+
+struct SubmitEvent {};
+struct ApproveEvent { unsigned votes; };
+struct RejectEvent {};
+struct PublishEvent {};
+struct ArchiveEvent {};
+struct CommentEvent {};
+
+struct Draft;
+struct Approved;
+struct Published;
+struct Archived;
+
+// composite state of Review, never entered itself
+struct Active
+{
+    using targets = std::tuple<>;
+
+    static void handle(auto* doc, const CommentEvent&)
+    {
+        ++doc->comments;
+    }
+};
+
+struct Draft {};
+struct Review { using parent = Active; };
+struct Approved {};
+
+struct Published
+{
+    using targets = std::tuple<Archived>;
+
+    static void handle(auto* doc, const ArchiveEvent&)
+    {
+        doc->template enterState<Archived>();
+    }
+};
+
+struct Archived {};
+
+// dead: no live state can enter it, so its handler is never compiled nor dispatched
+struct Orphan
+{
+    static void handle(auto* doc, const SubmitEvent&)
+    {
+        ++doc->orphanSubmits;
+        doc->template enterState<Draft>();
+    }
+};
+
+// dead, with a transition in the table
+struct Legacy {};
+
+using Quorum = decltype([](const auto&, const ApproveEvent& ev) { return ev.votes >= 2; });
+
+using states_t = std::tuple<Draft, Active, Review, Approved, Published, Archived, Orphan, Legacy>;
+using events_t = std::tuple<SubmitEvent, ApproveEvent, RejectEvent, PublishEvent, ArchiveEvent, CommentEvent>;
+
+struct Document : tiniest_fsm::StateMachine<Document, states_t,
+    tiniest_fsm::TransitionTable<
+        tiniest_fsm::Transition<Draft, SubmitEvent, Review>,
+        tiniest_fsm::Transition<Review, ApproveEvent, Approved, Quorum>,
+        tiniest_fsm::Transition<Review, RejectEvent, Draft>,
+        tiniest_fsm::Transition<Approved, PublishEvent, Published>,
+        tiniest_fsm::Transition<Legacy, PublishEvent, Published>
+    >,
+    tiniest_fsm::EventTypes<SubmitEvent, ApproveEvent, RejectEvent, PublishEvent, ArchiveEvent, CommentEvent>,
+    tiniest_fsm::ReachableFrom<>>
+{
+    unsigned comments = 0;
+    unsigned orphanSubmits = 0;
+};
+
+using R = tiniest_fsm::Reflection<Document, events_t>;
+
+static_assert(Document::isReachable<Published>() && Document::isReachable<Archived>() && !Document::isReachable<Orphan>());
+
+bool check(bool ok, const std::string& what)
+{
+    std::cout << what << ": " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+// enters the state with the given id, by its type
+template <typename FSM, typename...States>
+void enterStateId(FSM& fsm, unsigned id, std::tuple<States...>*)
+{
+    unsigned i = 0;
+    (void)((i++ == id && (fsm.template enterState<States>(), true)) || ...);
+}
+
+// the states reachable from the first one, by a plain search of the transitions and targets listed by the reflection
+std::vector<bool> search()
+{
+    std::vector<bool> reached(R::stateCount);
+    std::vector<unsigned> pending = { 0 };
+    reached[0] = true;
+    while (!pending.empty()) {
+        const unsigned s = pending.back();
+        pending.pop_back();
+        auto visit = [&](unsigned from, unsigned to) {
+            // the transitions and targets of a state apply also to its descendants
+            for (unsigned a = s; a < R::stateCount; a = R::parents[a])
+                if (a == from && !reached[to]) {
+                    reached[to] = true;
+                    pending.push_back(to);
+                }
+        };
+        for (const tiniest_fsm::TransitionInfo& t : R::transitions)
+            visit(t.from, t.to);
+        for (const tiniest_fsm::TargetInfo& t : R::targets)
+            visit(t.from, t.to);
+    }
+    return reached;
+}
+
+int main()
+{
+    bool ok = true;
+
+    // handles, against the result of processRaw in each live state (with the guards passing)
+    const SubmitEvent submit;
+    const ApproveEvent approve{ 3 };
+    const RejectEvent reject;
+    const PublishEvent publish;
+    const ArchiveEvent archive;
+    const CommentEvent comment;
+    const void* evs[R::eventCount] = { &submit, &approve, &reject, &publish, &archive, &comment };
+    bool handles = true;
+    for (unsigned e = 0; e < R::eventCount; ++e)
+        for (unsigned s = 0; s < R::stateCount; ++s)
+            if (R::reachable[s]) {
+                Document doc;
+                enterStateId(doc, s, (states_t*)nullptr);
+                handles = handles && doc.processRaw(e, evs[e]) == R::handles[e][s];
+            }
+    ok &= check(handles && R::handles[5][2] && !R::handles[5][0], "handles agrees with processRaw");
+
+    // reachable, against a plain search and against the state machine
+    const std::vector<bool> reached = search();
+    bool reachable = true;
+    for (unsigned s = 0; s < R::stateCount; ++s)
+        reachable = reachable && reached[s] == R::reachable[s];
+    ok &= check(reachable && R::reachable[4] && R::reachable[5] && !R::reachable[1] && !R::reachable[6] && !R::reachable[7],
+        "reachable agrees with a plain search");
+
+    // a dead state entered from outside ignores all events
+    Document doc;
+    doc.enterState<Orphan>();
+    doc.process(SubmitEvent{});
+    ok &= check(doc.inState<Orphan>() && doc.orphanSubmits == 0, "dead states are not dispatched");
+
+    // a run through the live states
+    doc.enterState<Draft>();
+    doc.process(SubmitEvent{});
+    doc.process(CommentEvent{});
+    doc.process(ApproveEvent{ 1 });
+    const bool inReview = doc.inState<Review>();
+    doc.process(ApproveEvent{ 2 });
+    doc.process(PublishEvent{});
+    doc.process(ArchiveEvent{});
+    ok &= check(inReview && doc.inState<Archived>() && doc.comments == 1, "live states");
+
+    const std::string_view dot =
+        "digraph G {\n"
+        "  rankdir=LR\n"
+        "  start [shape=point];\n"
+        "  start -> \"Draft\";\n"
+        "  \"Active\" [color=gray, fontcolor=gray];\n"
+        "  \"Orphan\" [color=gray, fontcolor=gray];\n"
+        "  \"Legacy\" [color=gray, fontcolor=gray];\n"
+        "  \"Draft\" -> \"Review\" [label=\"SubmitEvent\"];\n"
+        "  \"Review\" -> \"Approved\" [label=\"ApproveEvent [guard]\"];\n"
+        "  \"Review\" -> \"Draft\" [label=\"RejectEvent\"];\n"
+        "  \"Approved\" -> \"Published\" [label=\"PublishEvent\"];\n"
+        "  \"Legacy\" -> \"Published\" [label=\"PublishEvent\"];\n"
+        "  \"Published\" -> \"Archived\" [style=dashed];\n"
+        "}\n";
+    ok &= check(R::dot == dot, "DOT diagram");
+    if (R::dot != dot)
+        std::cout << R::dot;
+    return ok ? 0 : 1;
+}
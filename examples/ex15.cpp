@@ -0,0 +1,126 @@
+#include <tiniestfsm_pool.h>
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// checks StateMachinePool::broadcast against plain process on a copy of each instance, for events handled by
+// one state (a single SIMD pass), by 5 states (a SIMD pass per state) and by more than 8 states (a counting sort),
+// with 8 bit and 16 bit state ids. The handlers move to other handling states, which must not process the event twice.
+
+struct SingleEvent { unsigned salt; };
+struct FewEvent { unsigned salt; };
+struct ManyEvent { unsigned salt; };
+struct NoneEvent {};
+
+template <unsigned N>
+struct Model
+{
+    template <unsigned I>
+    struct S
+    {
+        // the next state depends on the data of the instance: with +7, from a state which handles FewEvent
+        // (or ManyEvent) to another one, whose run comes later in broadcast
+        template <typename FSM>
+        static void step(FSM* fsm, unsigned salt)
+        {
+            fsm->trace = fsm->trace * 31 + I + salt;
+            if ((fsm->trace >> 3) % 2)
+                fsm->template enterState<S<(I + 7) % N>>();
+            else
+                fsm->template enterState<S<(I + 1) % N>>();
+        }
+
+        static void handle(auto* fsm, const SingleEvent& ev) requires (I == 3) { step(fsm, ev.salt); }
+        static void handle(auto* fsm, const FewEvent& ev) requires (I % 7 == 1 && I < 35) { step(fsm, ev.salt); }
+        static void handle(auto* fsm, const ManyEvent& ev) requires (I % 3 != 0) { step(fsm, ev.salt); }
+    };
+
+    template <typename Is = std::make_integer_sequence<unsigned, N>>
+    struct states;
+
+    template <unsigned...Is>
+    struct states<std::integer_sequence<unsigned, Is...>> { using type = std::tuple<S<Is>...>; };
+
+    using states_t = typename states<>::type;
+
+    struct Fsm : tiniest_fsm::StateMachine<Fsm, states_t>
+    {
+        unsigned trace = 0;
+    };
+
+    template <typename Event>
+    static constexpr size_t handling_v = tiniest_fsm::details::handling_states_t<Fsm, Event>::size;
+
+    static_assert(handling_v<NoneEvent> == 0 && handling_v<SingleEvent> == 1 && handling_v<FewEvent> == 5 && handling_v<ManyEvent> > 8);
+
+    // enters the state with the given id, by its type
+    template <typename F, typename...States>
+    static void withState(unsigned id, F&& f, std::tuple<States...>*)
+    {
+        unsigned i = 0;
+        (void)((i++ == id && (f.template operator()<States>(), true)) || ...);
+    }
+
+    static bool same(const tiniest_fsm::StateMachinePool<Fsm>& pool, const std::vector<Fsm>& plain)
+    {
+        bool ok = pool.size() == plain.size();
+        for (size_t i = 0; ok && i < plain.size(); ++i)
+            ok = pool.currentStateId(i) == plain[i].currentStateId() && pool[i].currentStateId() == plain[i].currentStateId()
+                && pool[i].trace == plain[i].trace;
+        return ok;
+    }
+
+    // instances in random states, many of them in the state which handles SingleEvent, receive random events
+    static bool run(size_t n)
+    {
+        std::mt19937 rng(N);
+        tiniest_fsm::StateMachinePool<Fsm> pool;
+        std::vector<Fsm> plain(n);
+        for (size_t i = 0; i < n; ++i) {
+            pool.template emplace<S<0>>();
+            const unsigned id = rng() % 4 == 0 ? 3 : unsigned(rng() % N);
+            withState(id, [&]<typename State>() {
+                pool.template enterState<State>(i);
+                plain[i].template enterState<State>();
+            }, (states_t*)nullptr);
+            plain[i].trace = unsigned(i);
+            pool.modify(i, [&](Fsm& fsm) { fsm.trace = unsigned(i); });
+        }
+
+        bool ok = same(pool, plain);
+        auto broadcast = [&](const auto& ev) {
+            pool.broadcast(ev);
+            for (Fsm& fsm : plain)
+                fsm.process(ev);
+            ok = ok && same(pool, plain);
+        };
+        for (unsigned step = 0; step < 200; ++step) {
+            const unsigned salt = unsigned(rng());
+            switch (rng() % 4) {
+            case 0: broadcast(SingleEvent{ salt }); break;
+            case 1: broadcast(FewEvent{ salt }); break;
+            case 2: broadcast(ManyEvent{ salt }); break;
+            default: broadcast(NoneEvent{}); break;
+            }
+        }
+        return ok;
+    }
+};
+
+bool check(bool ok, const std::string& what)
+{
+    std::cout << what << ": " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    // sizes which are not multiples of the SIMD blocks
+    ok &= check(Model<32>::run(1003), "broadcast matches process, 32 states (8 bit ids)");
+    ok &= check(Model<32>::run(5), "broadcast matches process, 32 states, 5 instances");
+    ok &= check(Model<260>::run(1003), "broadcast matches process, 260 states (16 bit ids)");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#include <tiniestfsm.h>
+
+#include <iostream>
+
+struct OpenEvent {};
+struct CloseEvent {};
+struct LockEvent { unsigned key; };
+struct UnlockEvent { unsigned key; };
+
+struct OpenState {};
+struct CloseState {};
+
+struct LockedState
+{
+    static void enter(auto* door)
+    {
+        std::cout << "entering LockedState\n";
+    }
+};
+
+// guard: the key of the event matches the key of the door
+struct KeyMatches
+{
+    bool operator()(const auto& door, const auto& ev) const { return ev.key == door.m_key; }
+};
+
+// action: prints a message
+using Squeak = decltype([](auto& door, const auto& ev) { std::cout << "squeak\n"; });
+
+struct MyFSM : public tiniest_fsm::StateMachine<MyFSM, std::tuple<OpenState, CloseState, LockedState>,
+    tiniest_fsm::TransitionTable<
+        tiniest_fsm::Transition<OpenState, CloseEvent, CloseState, void, Squeak>,
+        tiniest_fsm::Transition<CloseState, OpenEvent, OpenState, void, Squeak>,
+        tiniest_fsm::Transition<CloseState, LockEvent, LockedState, KeyMatches>,
+        tiniest_fsm::Transition<LockedState, UnlockEvent, CloseState, KeyMatches>
+    >>
+{
+    MyFSM(unsigned key) : m_key(key) {}
+    unsigned m_key;
+};
+
+int main()
+{
+    MyFSM fsm{123u};
+    fsm.enterState<OpenState>();
+    fsm.process(CloseEvent{});
+    fsm.process(OpenEvent{});
+    fsm.process(CloseEvent{});
+    fsm.process(LockEvent{ 521u });    // wrong key, nothing happens
+    fsm.process(LockEvent{ 123u });
+    fsm.process(UnlockEvent{ 521u });  // wrong key, nothing happens
+    fsm.process(UnlockEvent{ 123u });
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <tiniestfsm.h>
+
+#include <iostream>
+
+struct LoginEvent {};
+struct HaltEvent {};
+struct ResumeEvent {};
+struct OrderEvent { unsigned qty; };
+struct HeartbeatEvent {};
+struct DisconnectEvent {};
+
+struct Disconnected;
+struct Trading;
+struct Halted;
+
+// composite state: handles events common to all its descendants
+struct Connected
+{
+    static void handle(auto* session, const HeartbeatEvent&)
+    {
+        std::cout << "heartbeat\n";
+    }
+
+    static void handle(auto* session, const DisconnectEvent&)
+    {
+        std::cout << "disconnecting\n";
+        session->template enterState<Disconnected>();
+    }
+};
+
+struct LoggingIn
+{
+    using parent = Connected;
+
+    static void handle(auto* session, const LoginEvent&)
+    {
+        session->template enterState<Trading>();
+    }
+};
+
+struct LoggedIn
+{
+    using parent = Connected;
+
+    static void handle(auto* session, const OrderEvent& ev)
+    {
+        std::cout << "order rejected, qty " << ev.qty << "\n";
+    }
+};
+
+struct Trading
+{
+    using parent = LoggedIn;
+
+    static void handle(auto* session, const OrderEvent& ev)
+    {
+        std::cout << "order accepted, qty " << ev.qty << "\n";
+    }
+
+    static void handle(auto* session, const HaltEvent&)
+    {
+        session->template enterState<Halted>();
+    }
+};
+
+struct Halted
+{
+    using parent = LoggedIn;
+
+    static void handle(auto* session, const ResumeEvent&)
+    {
+        session->template enterState<Trading>();
+    }
+};
+
+struct Disconnected {};
+
+struct Session : public tiniest_fsm::StateMachine<Session, std::tuple<Disconnected, Connected, LoggingIn, LoggedIn, Trading, Halted>>
+{
+};
+
+int main()
+{
+    Session session;
+    session.enterState<LoggingIn>();
+    session.process(HeartbeatEvent{});  // handled by Connected
+    session.process(LoginEvent{});
+    session.process(OrderEvent{ 10 });  // handled by Trading
+    session.process(HaltEvent{});
+    session.process(OrderEvent{ 20 });  // handled by LoggedIn
+    session.process(HeartbeatEvent{});  // handled by Connected
+    std::cout << "logged in: " << session.inState<LoggedIn>() << "\n";
+    session.process(DisconnectEvent{}); // handled by Connected
+    std::cout << "connected: " << session.inState<Connected>() << "\n";
+    return 0;
+}
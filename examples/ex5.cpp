@@ -0,0 +1,99 @@
+#include <tiniestfsm.h>
+#include <tiniestfsm_pool.h>
+
+#include <coroutine>
+#include <iostream>
+#include <vector>
+
+// checks that, while a coroutine handler is suspended, events are queued (also by broadcast) and processed in order
+// when it completes, and that events which do not fit in the queue are reported
+
+struct QuoteRequest { unsigned id; };
+struct PingEvent { unsigned id; };
+
+// the pending replies, resumed by the event loop in main
+std::vector<std::coroutine_handle<>> g_pending;
+
+struct Reply
+{
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> h) { g_pending.push_back(h); }
+    void await_resume() const {}
+};
+
+void resumeAll()
+{
+    std::vector<std::coroutine_handle<>> pending;
+    pending.swap(g_pending);
+    for (auto h : pending)
+        h.resume();
+}
+
+struct Quoted;
+
+struct Idle
+{
+    static tiniest_fsm::Task handle(auto* fsm, QuoteRequest req)
+    {
+        co_await Reply{};
+        fsm->log.push_back(req.id);
+        fsm->template enterState<Quoted>();
+    }
+};
+
+struct Quoted
+{
+    static void handle(auto* fsm, const PingEvent& ev)
+    {
+        fsm->log.push_back(ev.id);
+    }
+};
+
+struct Order : tiniest_fsm::StateMachine<Order, std::tuple<Idle, Quoted>,
+                                         tiniest_fsm::EventQueue<4, QuoteRequest, PingEvent>,
+                                         tiniest_fsm::AsyncHandlers<>>
+{
+    std::vector<unsigned> log;
+};
+
+bool check(bool ok, const char* what)
+{
+    std::cout << what << ": " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+
+    // the pings are queued while the quote is pending, and handled after it in Quoted
+    Order order;
+    order.process(QuoteRequest{ 0 });
+    ok &= check(order.suspended(), "suspended");
+    order.process(PingEvent{ 1 });
+    order.process(PingEvent{ 2 });
+    ok &= check(order.log.empty() && order.pendingEvents() == 2, "events queued while suspended");
+    resumeAll();
+    ok &= check(!order.suspended() && order.log == std::vector<unsigned>{ 0, 1, 2 }, "queued events processed in order");
+
+    // events beyond the capacity of the queue are dropped, and counted
+    Order full;
+    full.process(QuoteRequest{ 0 });
+    for (unsigned i = 1; i <= 6; ++i)
+        full.process(PingEvent{ i });
+    ok &= check(full.pendingEvents() == 4 && full.droppedEvents() == 2, "overflow reported");
+    resumeAll();
+    ok &= check(full.log == std::vector<unsigned>{ 0, 1, 2, 3, 4 }, "queued events processed after overflow");
+
+    // broadcast queues the event in the suspended instances, and dispatches it in the others
+    tiniest_fsm::StateMachinePool<Order> pool;
+    const size_t suspended = pool.emplace<Idle>();
+    const size_t quoted = pool.emplace<Quoted>();
+    pool.process(suspended, QuoteRequest{ 0 });
+    pool.broadcast(PingEvent{ 1 });
+    ok &= check(pool[suspended].log.empty() && pool[quoted].log == std::vector<unsigned>{ 1 }, "broadcast while suspended");
+    resumeAll();
+    ok &= check(pool[suspended].log == std::vector<unsigned>{ 0, 1 }, "broadcast event processed after completion");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#include <tiniestfsm_concurrent.h>
+#include <tiniestfsm_executor.h>
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// checks that the events sent by each producer are processed in the order they were sent, by ConcurrentStateMachine
+// and by FsmExecutor, and that idle FsmExecutor workers sleeping in the kernel are woken to steal work
+
+constexpr unsigned s_nProducers = 4;
+constexpr unsigned s_nEvents = 20000;  // per producer
+
+struct SeqEvent { unsigned producer; unsigned seq; };
+struct SlowEvent {};
+
+// the threads which processed a SlowEvent
+std::mutex g_mutex;
+std::set<std::thread::id> g_threads;
+
+struct Counting
+{
+    static void handle(auto* fsm, const SeqEvent& ev)
+    {
+        fsm->inOrder = fsm->inOrder && ev.seq == fsm->next[ev.producer];
+        fsm->next[ev.producer] = ev.seq + 1;
+    }
+
+    static void handle(auto*, const SlowEvent&)
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_threads.insert(std::this_thread::get_id());
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+};
+
+struct Counter : tiniest_fsm::StateMachine<Counter, std::tuple<Counting>>
+{
+    std::array<unsigned, s_nProducers> next{};
+    bool inOrder = true;
+};
+
+bool check(bool ok, const char* what)
+{
+    std::cout << what << ": " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+bool concurrentOrder()
+{
+    tiniest_fsm::ConcurrentStateMachine<Counter, std::tuple<SeqEvent>, tiniest_fsm::QueueCapacity<256>> counter;
+    std::thread consumer([&] { counter.run(); });
+    std::vector<std::thread> producers;
+    for (unsigned p = 0; p < s_nProducers; ++p)
+        producers.emplace_back([&, p] {
+            for (unsigned i = 0; i < s_nEvents; ++i)
+                counter.post(SeqEvent{ p, i });
+        });
+    for (std::thread& t : producers)
+        t.join();
+    counter.requestStop();
+    consumer.join();
+
+    const Counter& c = counter.machine();
+    bool ok = c.inOrder;
+    for (unsigned p = 0; p < s_nProducers; ++p)
+        ok = ok && c.next[p] == s_nEvents;
+    return ok;
+}
+
+template <typename Wait>
+bool executorOrder()
+{
+    constexpr uint64_t nKeys = 64;
+    tiniest_fsm::FsmExecutor<Counter, std::tuple<SeqEvent>, tiniest_fsm::QueueCapacity<64>, tiniest_fsm::WaitStrategy<Wait>> exec(4, 16, s_nProducers);
+    for (uint64_t key = 0; key < nKeys; ++key)
+        exec.template emplace<Counting>(key);
+    exec.start();
+    std::vector<std::thread> producers;
+    for (unsigned p = 0; p < s_nProducers; ++p)
+        producers.emplace_back([&, p] {
+            auto producer = exec.producer(p);
+            for (unsigned i = 0; i < s_nEvents; ++i)
+                producer.post(i % nKeys, SeqEvent{ p, i / unsigned(nKeys) });
+        });
+    for (std::thread& t : producers)
+        t.join();
+    exec.stop();
+
+    bool ok = true;
+    for (uint64_t key = 0; key < nKeys; ++key) {
+        const Counter& c = exec[key];
+        ok = ok && c.inOrder;
+        for (unsigned p = 0; p < s_nProducers; ++p)
+            ok = ok && c.next[p] == (s_nEvents - key + nKeys - 1) / nKeys;
+    }
+    return ok;
+}
+
+// all events are sent to the shards of worker 0: the other workers, sleeping, must be woken to steal them
+bool executorStealing()
+{
+    constexpr size_t nWorkers = 4;
+    constexpr size_t nShards = 16;
+    tiniest_fsm::FsmExecutor<Counter, std::tuple<SlowEvent>, tiniest_fsm::WaitStrategy<tiniest_fsm::FutexWait>> exec(nWorkers, nShards, 1);
+    for (uint64_t key = 0; key < nShards; key += nWorkers)
+        exec.emplace<Counting>(key);
+    exec.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));  // let the workers go to sleep
+    auto producer = exec.producer(0);
+    for (unsigned i = 0; i < 200; ++i)
+        producer.post(uint64_t(i % (nShards / nWorkers)) * nWorkers, SlowEvent{});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    size_t nThreads;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        nThreads = g_threads.size();
+    }
+    exec.stop();
+    return nThreads > 1;
+}
+
+int main()
+{
+    bool ok = true;
+    ok &= check(concurrentOrder(), "ConcurrentStateMachine: events of each producer in order");
+    ok &= check(executorOrder<tiniest_fsm::YieldWait>(), "FsmExecutor, YieldWait: events of each producer in order");
+    ok &= check(executorOrder<tiniest_fsm::FutexWait>(), "FsmExecutor, FutexWait: events of each producer in order");
+    ok &= check(executorStealing(), "FsmExecutor, FutexWait: idle workers woken to steal");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+#include <tiniestfsm_shared.h>
+
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// checks that a process reading a pool in shared memory, while another process modifies it, always sees
+// consistent instances and state ids, and that instances left inconsistent by a writer which terminated are poisoned
+// until the next writer re-initializes them
+
+constexpr size_t s_nInstances = 16;
+constexpr unsigned s_nUpdates = 200000;
+
+struct CountEvent {};
+
+struct Even;
+
+struct Odd
+{
+    static void handle(auto* counter, const CountEvent&)
+    {
+        counter->count = ++counter->copy;
+        counter->template enterState<Even>();
+    }
+};
+
+struct Even
+{
+    static void handle(auto* counter, const CountEvent&)
+    {
+        counter->count = ++counter->copy;
+        counter->template enterState<Odd>();
+    }
+};
+
+// count and copy are always equal, and the state is Odd if count is odd, between modifications
+struct Counter : tiniest_fsm::StateMachine<Counter, std::tuple<Even, Odd>>
+{
+    unsigned count = 0;
+    unsigned copy = 0;
+};
+
+bool check(bool ok, const char* what)
+{
+    std::cout << what << ": " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+// reads the instances until the last update is seen, returns true if all reads are consistent
+bool reader(const char* name)
+{
+    tiniest_fsm::SharedPoolReader<Counter> pool(name);
+    while (pool.size() < s_nInstances) {}
+    bool ok = true;
+    for (bool done = false; !done;) {
+        done = true;
+        for (size_t i = 0; i < s_nInstances; ++i) {
+            const unsigned id = pool.currentStateId(i);
+            const Counter c = pool.read(i);
+            ok = ok && c.count == c.copy && c.currentStateId() == c.count % 2 && id < 2;
+            done = done && c.count == s_nUpdates;
+        }
+    }
+    return ok;
+}
+
+// a writer terminates while modifying instance 3, the next writer finds it poisoned and re-initializes it
+bool poisoned(const char* name)
+{
+    using pool_t = tiniest_fsm::StateMachinePool<Counter, tiniest_fsm::SharedPoolStorage>;
+    {
+        pool_t pool(name, s_nInstances);
+        for (size_t i = 0; i < s_nInstances; ++i)
+            pool.emplace<Even>();
+        pool.broadcast(CountEvent{});
+        const pid_t child = ::fork();
+        if (child == 0) {
+            pool.storage().beginWrite(3);
+            pool.modify(5, [](Counter& c) { c.copy = 0; });
+            ::_exit(0);
+        }
+        ::waitpid(child, nullptr, 0);
+    }
+
+    tiniest_fsm::SharedPoolReader<Counter> reader(name);
+    pool_t pool(name, s_nInstances);
+    bool ok = pool.storage().poisoned().size() == 1 && pool.storage().poisoned()[0] == 3
+        && reader.poisoned(3) && !reader.poisoned(5) && reader.read(5).copy == 0;
+    bool threw = false;
+    try {
+        reader.read(3);
+    }
+    catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ok = ok && threw;
+
+    pool.modify(3, [](Counter& c) {
+        c = Counter{};
+        c.enterState<Even>();
+    });
+    const Counter c = reader.read(3);
+    ok = ok && pool.storage().poisoned().empty() && !reader.poisoned(3) && c.count == 0 && c.currentStateId() == 0
+        && reader.currentStateId(3) == 0;
+
+    // further modifications count from 0 as usual
+    pool.process(3, CountEvent{});
+    ok = ok && reader.read(3).count == 1 && reader.currentStateId(3) == 1;
+    return ok;
+}
+
+int main()
+{
+    const std::string name = "/tiniestfsm_ex7_" + std::to_string(::getpid());
+    bool ok = true;
+    {
+        tiniest_fsm::StateMachinePool<Counter, tiniest_fsm::SharedPoolStorage> pool(name.c_str(), s_nInstances);
+        const pid_t child = ::fork();
+        if (child == 0)
+            return reader(name.c_str()) ? 0 : 1;
+
+        for (size_t i = 0; i < s_nInstances; ++i)
+            pool.emplace<Even>();
+        for (unsigned n = 0; n < s_nUpdates; ++n)
+            pool.broadcast(CountEvent{});
+
+        ok &= check(pool[0].count == s_nUpdates && pool.currentStateId(0) == s_nUpdates % 2, "writer");
+        int status = 0;
+        ::waitpid(child, &status, 0);
+        ok &= check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "reader sees consistent instances");
+    }
+    tiniest_fsm::SharedPoolStorage::remove(name.c_str());
+
+    ok &= check(poisoned(name.c_str()), "instances being modified by a terminated writer are poisoned");
+    tiniest_fsm::SharedPoolStorage::remove(name.c_str());
+    return ok ? 0 : 1;
+}
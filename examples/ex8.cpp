@@ -0,0 +1,135 @@
+#include <tiniestfsm_trace.h>
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// checks that the records copied by RingBufferTracer::snapshot, while another thread is recording, are never torn:
+// the state machine cycles through its states, so each record is determined by the previous one
+// (build with make tsan to run it under ThreadSanitizer); also checks that a tracer which implements only onHandled
+// is invoked for events handled in the same way by all states
+
+constexpr unsigned s_nStates = 5;
+constexpr unsigned s_nSteps = 200000;
+constexpr size_t s_capacity = 64;
+
+struct StepEvent {};
+
+template <unsigned I>
+struct Step
+{
+    static void handle(auto* fsm, const StepEvent&)
+    {
+        fsm->template enterState<Step<(I + 1) % s_nStates>>();
+    }
+};
+
+struct Cycle : tiniest_fsm::StateMachine<Cycle, std::tuple<Step<0>, Step<1>, Step<2>, Step<3>, Step<4>>,
+                                         tiniest_fsm::Tracer<tiniest_fsm::RingBufferTracer<s_capacity>>>
+{
+};
+
+// all states handle PingEvent with the same handler
+struct PingEvent {};
+
+struct Pingable
+{
+    static void handle(auto* fsm, const PingEvent&)
+    {
+        ++fsm->pings;
+    }
+};
+
+template <unsigned I>
+struct Idle : Pingable
+{
+    using Pingable::handle;
+
+    static void handle(auto* fsm, const StepEvent&)
+    {
+        fsm->template enterState<Idle<(I + 1) % 3>>();
+    }
+};
+
+struct HandledCounter
+{
+    unsigned handled = 0;
+
+    template <typename State, typename FSM, typename Event>
+    void onHandled(const FSM&, const Event&)
+    {
+        ++handled;
+    }
+};
+
+struct Pinged : tiniest_fsm::StateMachine<Pinged, std::tuple<Idle<0>, Idle<1>, Idle<2>>, tiniest_fsm::Tracer<HandledCounter>>
+{
+    unsigned pings = 0;
+};
+
+struct Untraced : tiniest_fsm::StateMachine<Untraced, std::tuple<Idle<0>, Idle<1>, Idle<2>>>
+{
+    unsigned pings = 0;
+};
+
+static_assert(Untraced::dispatchStrategy<PingEvent>() == tiniest_fsm::DispatchStrategy::Uniform);
+static_assert(Pinged::dispatchStrategy<PingEvent>() != tiniest_fsm::DispatchStrategy::Uniform);
+
+bool check(bool ok, const char* what)
+{
+    std::cout << what << ": " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+// true if the record is well formed, and is the one which follows prev (if not null)
+bool follows(const tiniest_fsm::TraceRecord& r, const tiniest_fsm::TraceRecord* prev)
+{
+    using tiniest_fsm::TraceKind;
+    if (r.kind == TraceKind::Event) {
+        if (r.eventType != tiniest_fsm::details::type_hash<StepEvent>() || r.target != 0 || r.state >= s_nStates)
+            return false;
+        return !prev || (prev->kind == TraceKind::Enter && prev->target == r.state);
+    }
+    if (r.kind == TraceKind::Enter) {
+        if (r.eventType != 0 || r.state >= s_nStates || r.target != (r.state + 1) % s_nStates)
+            return false;
+        return !prev || (prev->kind == TraceKind::Event && prev->state == r.state);
+    }
+    return false;
+}
+
+int main()
+{
+    Cycle cycle;
+    std::atomic<bool> done{ false };
+    std::thread writer([&] {
+        for (unsigned i = 0; i < s_nSteps; ++i)
+            cycle.process(StepEvent{});
+        done.store(true, std::memory_order_release);
+    });
+
+    bool ok = true;
+    size_t nSnapshots = 0;
+    std::vector<tiniest_fsm::TraceRecord> records(s_capacity);
+    while (!done.load(std::memory_order_acquire) || nSnapshots == 0) {
+        const size_t n = cycle.tracer().snapshot(records);
+        for (size_t i = 0; i < n; ++i)
+            ok = ok && follows(records[i], i > 0 ? &records[i - 1] : nullptr);
+        ++nSnapshots;
+    }
+    writer.join();
+
+    ok &= check(ok, "snapshots taken while recording are consistent");
+    const size_t n = cycle.tracer().snapshot(records);
+    ok &= check(n == s_capacity && cycle.tracer().count() == 2 * s_nSteps, "final snapshot");
+
+    Pinged pinged;
+    for (unsigned i = 0; i < 10; ++i) {
+        pinged.process(PingEvent{});
+        if (i % 3 == 0)
+            pinged.process(StepEvent{});
+    }
+    ok &= check(pinged.pings == 10 && pinged.tracer().handled == 14, "onHandled invoked for uniformly handled events");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include <tiniestfsm_replay.h>
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+// checks that replaying a log recorded by EventRecorder reproduces the events handled by the state machine,
+// including events posted and processed by handlers, and that corrupted logs are rejected
+
+struct OrderEvent { unsigned id; };
+struct FillEvent { unsigned id; };
+struct AuditEvent { unsigned id; };
+
+struct Open;
+
+struct Pending
+{
+    // the order is filled later, when the queue is drained
+    static void handle(auto* fsm, const OrderEvent& ev)
+    {
+        fsm->handled.push_back(ev.id);
+        fsm->post(FillEvent{ ev.id + 1000 });
+        fsm->process(AuditEvent{ ev.id + 2000 });
+    }
+
+    static void handle(auto* fsm, const FillEvent& ev)
+    {
+        fsm->handled.push_back(ev.id);
+        fsm->template enterState<Open>();
+    }
+
+    static void handle(auto* fsm, const AuditEvent& ev)
+    {
+        fsm->handled.push_back(ev.id);
+    }
+};
+
+struct Open
+{
+    static void handle(auto* fsm, const OrderEvent& ev)
+    {
+        fsm->handled.push_back(ev.id);
+        fsm->template enterState<Pending>();
+    }
+
+    static void handle(auto* fsm, const AuditEvent& ev)
+    {
+        fsm->handled.push_back(ev.id);
+    }
+};
+
+template <typename...Options>
+struct Book : tiniest_fsm::StateMachine<Book<Options...>, std::tuple<Pending, Open>,
+                                        tiniest_fsm::EventQueue<16, OrderEvent, FillEvent, AuditEvent>, Options...>
+{
+    std::vector<unsigned> handled;
+};
+
+using recorder_t = tiniest_fsm::EventRecorder<OrderEvent, FillEvent, AuditEvent>;
+using log_t = tiniest_fsm::EventLog<OrderEvent, FillEvent, AuditEvent>;
+
+bool check(bool ok, const char* what)
+{
+    std::cout << what << ": " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+// true if reading the log throws std::runtime_error
+bool rejected(const std::string& log)
+{
+    std::istringstream is(log);
+    try {
+        log_t l(is);
+    }
+    catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    bool ok = true;
+
+    Book<tiniest_fsm::Tracer<recorder_t>> recorded;
+    recorded.process(OrderEvent{ 1 });   // posts a fill, processes an audit
+    recorded.process(AuditEvent{ 2 });
+    recorded.post(OrderEvent{ 3 });      // not handled until drain
+    recorded.drain();                    // fill 1001, then order 3, which posts fill 1003
+    recorded.process(OrderEvent{ 4 });
+    recorded.drain();                    // fill 1003
+    ok &= check(recorded.tracer().count() == 6, "entries recorded");
+
+    std::stringstream file;
+    recorded.tracer().save(file);
+    const std::string bytes = file.str();
+    log_t log(file);
+
+    Book<> replayed;
+    log.replay(replayed);
+    ok &= check(replayed.handled == recorded.handled && replayed.currentStateId() == recorded.currentStateId()
+        && replayed.pendingEvents() == recorded.pendingEvents(), "replay reproduces the events handled");
+
+    // a header announcing more data than there is
+    tiniest_fsm::EventLogHeader h;
+    std::memcpy(&h, bytes.data(), sizeof(h));
+    h.bytes = uint64_t(1) << 40;
+    h.count = uint64_t(1) << 38;
+    ok &= check(rejected(std::string(reinterpret_cast<const char*>(&h), sizeof(h)) + bytes.substr(sizeof(h))), "huge header rejected");
+
+    // more entries than can fit in the bytes
+    std::memcpy(&h, bytes.data(), sizeof(h));
+    h.count = h.bytes + 1;
+    ok &= check(rejected(std::string(reinterpret_cast<const char*>(&h), sizeof(h)) + bytes.substr(sizeof(h))), "inconsistent header rejected");
+
+    ok &= check(rejected(bytes.substr(0, bytes.size() - 1)), "truncated log rejected");
+
+    return ok ? 0 : 1;
+}
@@ -4,6 +4,17 @@
 #include <type_traits>
 #include <algorithm>
 #include <array>
+#include <concepts>
+#include <coroutine>
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <variant>
 
 #define _TINIEST_FSM_DISPATCH_4(n, X) \
     X(n);                 \
@@ -20,58 +31,160 @@
     _TINIEST_FSM_DISPATCH_16(n + 16, X); \
     _TINIEST_FSM_DISPATCH_16(n + 32, X); \
     _TINIEST_FSM_DISPATCH_16(n + 48, X)
-#define _TINIEST_FSM_DISPATCH_256(n, X)   \
-    _TINIEST_FSM_DISPATCH_64(n, X);       \
-    _TINIEST_FSM_DISPATCH_64(n + 64, X);  \
-    _TINIEST_FSM_DISPATCH_64(n + 128, X); \
-    _TINIEST_FSM_DISPATCH_64(n + 192, X)
+#define _TINIEST_FSM_DISPATCH_128(n, X)  \
+    _TINIEST_FSM_DISPATCH_64(n, X);      \
+    _TINIEST_FSM_DISPATCH_64(n + 64, X)
+#define _TINIEST_FSM_DISPATCH_256(n, X)    \
+    _TINIEST_FSM_DISPATCH_128(n, X);       \
+    _TINIEST_FSM_DISPATCH_128(n + 128, X)
 
 #define _TINIEST_FSM_DISPATCH(n, x) x(_TINIEST_FSM_DISPATCH##_##n, n)
 
 #if defined(__clang__) || defined(__GNUC__)
 #define _TINIEST_FSM_UNREACHABLE __builtin_unreachable()
+#define _TINIEST_FSM_HOT __attribute__((hot))
+#define _TINIEST_FSM_HAS_COMPUTED_GOTO
 #elif defined(_MSC_VER)
 #define _TINIEST_FSM_UNREACHABLE __assume(false)
+#define _TINIEST_FSM_HOT
 #else // unknown compiler
 #define _TINIEST_FSM_UNREACHABLE
+#define _TINIEST_FSM_HOT
 #endif
 
 #define _TINIEST_FSM_CASE(n)                    \
     case (n):                                   \
         if constexpr ((n) < s_nStates) {        \
-            processFromIndex<(n)>(ev);          \
-            break;                              \
+            return processFromIndex<(n)>(ev);   \
         }                                       \
         _TINIEST_FSM_UNREACHABLE
 
 #define _TINIEST_FSM_DISPATCH_IMPL(dispatcher, n)       \
-    switch (m_currentState) {                           \
+    switch (stateId()) {                                \
         dispatcher(0, _TINIEST_FSM_CASE);               \
     default:                                            \
         _TINIEST_FSM_UNREACHABLE;                       \
     }
 
+// labels of computed gotos, named by the two hex digits (h, l) of the state id
+#define _TINIEST_FSM_GOTO_ROW(h, X) \
+    X(h, 0) X(h, 1) X(h, 2) X(h, 3) X(h, 4) X(h, 5) X(h, 6) X(h, 7) \
+    X(h, 8) X(h, 9) X(h, a) X(h, b) X(h, c) X(h, d) X(h, e) X(h, f)
+#define _TINIEST_FSM_GOTO_16(X) _TINIEST_FSM_GOTO_ROW(0, X)
+#define _TINIEST_FSM_GOTO_256(X) \
+    _TINIEST_FSM_GOTO_ROW(0, X) _TINIEST_FSM_GOTO_ROW(1, X) _TINIEST_FSM_GOTO_ROW(2, X) _TINIEST_FSM_GOTO_ROW(3, X) \
+    _TINIEST_FSM_GOTO_ROW(4, X) _TINIEST_FSM_GOTO_ROW(5, X) _TINIEST_FSM_GOTO_ROW(6, X) _TINIEST_FSM_GOTO_ROW(7, X) \
+    _TINIEST_FSM_GOTO_ROW(8, X) _TINIEST_FSM_GOTO_ROW(9, X) _TINIEST_FSM_GOTO_ROW(a, X) _TINIEST_FSM_GOTO_ROW(b, X) \
+    _TINIEST_FSM_GOTO_ROW(c, X) _TINIEST_FSM_GOTO_ROW(d, X) _TINIEST_FSM_GOTO_ROW(e, X) _TINIEST_FSM_GOTO_ROW(f, X)
+
+#define _TINIEST_FSM_GOTO_ADDRESS(h, l) &&_tiniest_fsm_state_##h##l,
+
+#define _TINIEST_FSM_GOTO_LABEL(h, l)                   \
+    _tiniest_fsm_state_##h##l:                          \
+        if constexpr (0x##h##l < s_nStates) {           \
+            return processFromIndex<0x##h##l>(ev);      \
+        }                                               \
+        _TINIEST_FSM_UNREACHABLE;
+
+// a jump through a table of labels indexed by stateId(), with labels either _TINIEST_FSM_GOTO_16 or _TINIEST_FSM_GOTO_256
+#define _TINIEST_FSM_GOTO(labels)                                               \
+    static void* const s_labels[] = { labels(_TINIEST_FSM_GOTO_ADDRESS) };      \
+    goto *s_labels[stateId()];                                                  \
+    labels(_TINIEST_FSM_GOTO_LABEL)
+
+// a switch on stateId(), with the smallest number of cases which can fit s_nStates <= 256
+#define _TINIEST_FSM_SWITCH                                         \
+    if constexpr (s_nStates <= 4) {                                 \
+        _TINIEST_FSM_DISPATCH(4, _TINIEST_FSM_DISPATCH_IMPL)        \
+    }                                                               \
+    else if constexpr (s_nStates <= 16) {                           \
+        _TINIEST_FSM_DISPATCH(16, _TINIEST_FSM_DISPATCH_IMPL)       \
+    }                                                               \
+    else if constexpr (s_nStates <= 64) {                           \
+        _TINIEST_FSM_DISPATCH(64, _TINIEST_FSM_DISPATCH_IMPL)       \
+    }                                                               \
+    else if constexpr (s_nStates <= 128) {                          \
+        _TINIEST_FSM_DISPATCH(128, _TINIEST_FSM_DISPATCH_IMPL)      \
+    }                                                               \
+    else {                                                          \
+        static_assert(s_nStates <= 256);                            \
+        _TINIEST_FSM_DISPATCH(256, _TINIEST_FSM_DISPATCH_IMPL)      \
+    }
+
 namespace tiniest_fsm {
 
     namespace details {
 
+        // *****************************
+        // lookup of types in lists, with a constant template depth
+        //
+        // indexed_list<Ts...> derives from indexed_type<I, T> for each type T at position I in Ts, and a type is
+        // looked up by deducing the base class to which a pointer to the list converts. The list is instantiated
+        // once, and lookups do not instantiate recursive templates or fold expressions over all types, which with
+        // hundreds of states would dominate compile time and memory.
+        //
+
+        template <typename T>
+        struct type_tag {};
+
+        template <size_t I, typename T>
+        struct indexed_type : type_tag<T> {};
+
+        template <typename Seq, typename...Ts>
+        struct indexed_list_impl;
+
+        template <size_t...Is, typename...Ts>
+        struct indexed_list_impl<std::index_sequence<Is...>, Ts...> : indexed_type<Is, Ts>... {};
+
+        template <typename...Ts>
+        using indexed_list = indexed_list_impl<std::index_sequence_for<Ts...>, Ts...>;
+
+        inline constexpr size_t s_notInList = size_t(-1);
+
+        // the position of T, if T occurs exactly once in the list (deduction fails if there are several bases)
+        template <typename T, size_t I>
+        constexpr size_t index_in_list(const indexed_type<I, T>*) { return I; }
+
+        template <typename T>
+        constexpr size_t index_in_list(const void*) { return s_notInList; }
+
+        template <size_t I, typename T>
+        std::type_identity<T> type_in_list(const indexed_type<I, T>*);
+
+        // the type at position I in Ts
+        template <size_t I, typename...Ts>
+        using type_at_t = typename decltype(type_in_list<I>((indexed_list<Ts...>*)nullptr))::type;
+
+        // the type at position I in the std::tuple Tuple
+        template <size_t I, typename Tuple>
+        struct tuple_at;
+
+        template <size_t I, typename...Ts>
+        struct tuple_at<I, std::tuple<Ts...>> { using type = type_at_t<I, Ts...>; };
+
+        template <size_t I, typename Tuple>
+        using tuple_at_t = typename tuple_at<I, Tuple>::type;
+
+        // tests for type_at_t and tuple_at_t
+        static_assert(std::is_same_v<type_at_t<1, int, bool, int>, bool>);
+        static_assert(std::is_same_v<tuple_at_t<2, std::tuple<int, bool, double>>, double>);
+
         // returns true if type Elem is one of the types in List
+        // (std::is_base_of is true also if there is more than one base of type type_tag<Elem>)
         template <typename Elem, typename...List>
-        inline constexpr bool elem_in_list_v = (false || ... || std::is_same_v<Elem, List>);
+        inline constexpr bool elem_in_list_v = std::is_base_of_v<type_tag<Elem>, indexed_list<List...>>;
 
         // tests for elem_in_list_v
         static_assert(elem_in_list_v<int, int, bool>);
         static_assert(elem_in_list_v<int, int>);
         static_assert(elem_in_list_v<int, bool, int>);
+        static_assert(elem_in_list_v<int, int, bool, int>);
         static_assert(!elem_in_list_v<double, int, bool>);
-
-        // returns the number of occurrences of Elem in List
-        template <typename Elem, typename...List>
-        inline constexpr unsigned count_in_list_v = (0u + ... + std::is_same_v<Elem, List>);
+        static_assert(!elem_in_list_v<double>);
 
         // returns true if the list of types Ts contains no duplicates 
         template <typename...Ts>
-        inline constexpr bool are_distinct_v = (true && ... && (count_in_list_v<Ts, Ts...> == 1));
+        inline constexpr bool are_distinct_v = (true && ... && (index_in_list<Ts>((indexed_list<Ts...>*)nullptr) != s_notInList));
 
         // tests for are_distinct_v
         static_assert(!are_distinct_v<int, int, bool>);
@@ -79,22 +192,677 @@ namespace tiniest_fsm {
         static_assert(are_distinct_v<int>);
         static_assert(are_distinct_v<int, bool, double>);
 
+        // returns true if T is a specialization of std::variant
+        template <typename T>
+        inline constexpr bool is_variant_v = false;
+
+        template <typename...Ts>
+        inline constexpr bool is_variant_v<std::variant<Ts...>> = true;
+
+        // tests for is_variant_v
+        static_assert(is_variant_v<std::variant<int, bool>>);
+        static_assert(!is_variant_v<int>);
+
+        // returns the position of Elem in the std::tuple Tuple, or the size of Tuple if Elem is not in Tuple
+        template <typename Elem, typename Tuple>
+        inline constexpr size_t index_in_tuple_v = 0;
+
+        template <typename Elem, typename...Ts>
+        inline constexpr size_t index_in_tuple_v<Elem, std::tuple<Ts...>> =
+            std::min(index_in_list<Elem>((indexed_list<Ts...>*)nullptr), sizeof...(Ts));
+
+        // tests for index_in_tuple_v
+        static_assert(index_in_tuple_v<bool, std::tuple<int, bool>> == 1);
+        static_assert(index_in_tuple_v<double, std::tuple<int, bool>> == 2);
+
+        // returns true if the types in the std::tuple Tuple are distinct
+        template <typename Tuple>
+        inline constexpr bool distinct_tuple_v = false;
+
+        template <typename...Ts>
+        inline constexpr bool distinct_tuple_v<std::tuple<Ts...>> = are_distinct_v<Ts...>;
+
+        // tests for distinct_tuple_v
+        static_assert(distinct_tuple_v<std::tuple<int, bool>>);
+        static_assert(!distinct_tuple_v<std::tuple<int, bool, int>>);
+
+        // the smallest unsigned integer type which can represent all values in [0, N)
+        template <size_t N>
+        using uint_for_t =
+            std::conditional_t<(N <= (size_t(1) << 8)), uint8_t,
+            std::conditional_t<(N <= (size_t(1) << 16)), uint16_t,
+            uint32_t>>;
+
+        // tests for uint_for_t
+        static_assert(std::is_same_v<uint_for_t<1>, uint8_t>);
+        static_assert(std::is_same_v<uint_for_t<256>, uint8_t>);
+        static_assert(std::is_same_v<uint_for_t<257>, uint16_t>);
+        static_assert(std::is_same_v<uint_for_t<65537>, uint32_t>);
+
+        // a list of types
+        template <typename...Ts>
+        struct type_list {};
+
+        // concatenation of type lists
+        template <typename...As, typename...Bs>
+        constexpr type_list<As..., Bs...> operator+(type_list<As...>, type_list<Bs...>) { return {}; }
+
+        // returns the name of the type T, as spelled by the compiler
+        template <typename T>
+        constexpr std::string_view type_name()
+        {
+#if defined(__clang__) || defined(__GNUC__)
+            // e.g. "... type_name() [with T = Foo; ...]" (gcc) or "... type_name() [T = Foo]" (clang)
+            constexpr std::string_view s = __PRETTY_FUNCTION__;
+            constexpr size_t begin = s.find("T = ") + 4;
+            constexpr size_t semicolon = s.find(';', begin);
+            constexpr size_t end = semicolon != std::string_view::npos ? semicolon : s.rfind(']');
+            return s.substr(begin, end - begin);
+#elif defined(_MSC_VER)
+            // e.g. "... type_name<struct Foo>(void)"
+            constexpr std::string_view s = __FUNCSIG__;
+            constexpr size_t first = s.find("type_name<") + 10;
+            constexpr size_t begin = s.substr(first, 7) == "struct " ? first + 7 : s.substr(first, 6) == "class " ? first + 6 : first;
+            return s.substr(begin, s.rfind(">(void)") - begin);
+#else
+            return "unknown";
+#endif
+        }
+
+        // returns a 32 bits hash (FNV-1a) of the name of the type T, which is stable across runs
+        template <typename T>
+        constexpr uint32_t type_hash()
+        {
+            uint32_t h = 2166136261u;
+            for (char c : type_name<T>())
+                h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+            return h;
+        }
+
+        // tests for type_name
+#if defined(__clang__) || defined(__GNUC__) || defined(_MSC_VER)
+        static_assert(type_name<int>() == "int");
+        static_assert(type_hash<int>() != type_hash<unsigned>());
+#endif
+
+        // invokes before(), body() and after(token), where token is the value returned by before(),
+        // or after() if before() returns void
+        template <typename Before, typename Body, typename After>
+        constexpr void bracket(Before&& before, Body&& body, After&& after)
+        {
+            if constexpr (std::is_void_v<decltype(before())>) {
+                before();
+                body();
+                after();
+            }
+            else {
+                auto token = before();
+                body();
+                after(token);
+            }
+        }
+
+        // the parent of State in a hierarchy of states, i.e. State::parent, or void if State is a top level state
+        template <typename State>
+        struct parent_of { using type = void; };
+
+        template <typename State> requires requires { typename State::parent; }
+        struct parent_of<State> { using type = typename State::parent; };
+
+        template <typename State>
+        using parent_of_t = typename parent_of<State>::type;
+
+        // true if Ancestor is State, or its parent, or the parent of its parent, etc.
+        template <typename Ancestor, typename State>
+        constexpr bool is_ancestor_v = std::is_same_v<Ancestor, State> || is_ancestor_v<Ancestor, parent_of_t<State>>;
+
+        template <typename Ancestor>
+        constexpr bool is_ancestor_v<Ancestor, void> = false;
+
+        // the states which State declares as entered by its handlers, enter and exit, i.e. State::targets, or void
+        template <typename State>
+        struct declared_targets { using type = void; };
+
+        template <typename State> requires requires { typename State::targets; }
+        struct declared_targets<State> { using type = typename State::targets; };
+
+        // *****************************
+        // detection of the handlers of the states and of the hooks of the tracer
+        //
+        // These are at namespace scope rather than members of StateMachine: GCC takes time proportional to the number
+        // of instantiations of a member template of a class template to instantiate it once more, so evaluating a
+        // requires expression in a member template once per state grows quadratically with the number of states.
+        //
+
+        template <typename FSM, typename State, typename Event>
+        inline constexpr bool has_handler_v = requires (State && s, const Event & ev) { s.handle((FSM*)nullptr, ev); };
+
+        template <typename Tracer, typename FSM, typename State, typename Event>
+        inline constexpr bool traces_event_v = requires (Tracer & t, const FSM & f, const Event & ev) { t.template onEvent<State>(f, ev); };
+
+        // onHandled without the value returned by onEvent, for tracers which do not implement onEvent
+        template <typename Tracer, typename FSM, typename State, typename Event>
+        inline constexpr bool traces_handled_v = requires (Tracer & t, const FSM & f, const Event & ev) { t.template onHandled<State>(f, ev); };
+
+        template <typename Tracer, typename FSM, typename State, typename Event>
+        inline constexpr bool traces_unhandled_v = requires (Tracer & t, const FSM & f, const Event & ev) { t.template onUnhandled<State>(f, ev); };
+
+        template <typename Tracer, typename FSM, typename State>
+        inline constexpr bool traces_enter_v = requires (Tracer & t, const FSM & f) { t.template onEnter<State>(f, 0u); };
+
+        template <typename Tracer, typename FSM, typename State>
+        inline constexpr bool traces_entered_v = requires (Tracer & t, const FSM & f) { t.template onEntered<State>(f); };
+
+        // true if the transition table Table has a transition from State triggered by Event
+        template <typename Table, typename State, typename Event>
+        inline constexpr bool has_transition_v = !std::is_same_v<typename Table::template transitions_t<State, Event>, type_list<>>;
+
+        // the first of State, its parent, the parent of its parent, etc., which reacts to Event, either with a handler
+        // or with a transition in Table, or void if none
+        // This is how events bubble up the hierarchy of states, resolved at compile time.
+        template <typename FSM, typename Table, typename State, typename Event>
+        struct handling_state
+        {
+            using type = std::conditional_t<has_handler_v<FSM, State, Event> || has_transition_v<Table, State, Event>,
+                State, typename handling_state<FSM, Table, parent_of_t<State>, Event>::type>;
+        };
+
+        template <typename FSM, typename Table, typename Event>
+        struct handling_state<FSM, Table, void, Event> { using type = void; };
+
+        template <typename FSM, typename Table, typename State, typename Event>
+        using handling_state_t = typename handling_state<FSM, Table, State, Event>::type;
+
+        // true if the handler of Event in the current state State is a static member function
+        template <typename FSM, typename Table, typename State, typename Event>
+        inline constexpr bool has_static_handler_v = !has_transition_v<Table, handling_state_t<FSM, Table, State, Event>, Event>
+            && requires { static_cast<void (*)(FSM*, const Event&)>(&handling_state_t<FSM, Table, State, Event>::handle); };
+
+        // the address of the handler of Event in the current state State, if the handler is a static member function, or nullptr
+        template <typename FSM, typename Table, typename State, typename Event>
+        inline constexpr void (*static_handler_v)(FSM*, const Event&) = [] {
+            using handler_t = handling_state_t<FSM, Table, State, Event>;
+            if constexpr (has_static_handler_v<FSM, Table, State, Event>)
+                return static_cast<void (*)(FSM*, const Event&)>(&handler_t::handle);
+            else
+                return (void (*)(FSM*, const Event&))nullptr;
+        }();
+
+        // tests for parent_of_t and is_ancestor_v
+        struct test_root {};
+        struct test_child { using parent = test_root; };
+        struct test_leaf { using parent = test_child; };
+        static_assert(std::is_void_v<parent_of_t<test_root>>);
+        static_assert(std::is_same_v<parent_of_t<test_leaf>, test_child>);
+        static_assert(is_ancestor_v<test_root, test_leaf> && is_ancestor_v<test_leaf, test_leaf>);
+        static_assert(!is_ancestor_v<test_leaf, test_root>);
+
+        // all options of StateMachine derive from option_tag, via option<Kind>
+        struct option_tag {};
+
+        // Kind identifies the option, e.g. all specializations of StateIdStorage<Policy> derive from option<StateIdStorage<void>>
+        template <typename Kind>
+        struct option : option_tag { using kind = Kind; };
+
+        // returns the first type in Options whose kind is Kind, or Default if there is none
+        template <typename Kind, typename Default, typename...Options>
+        struct find_option { using type = Default; };
+
+        template <typename Kind, typename Default, typename Head, typename...Options>
+        struct find_option<Kind, Default, Head, Options...>
+            : std::conditional_t<std::is_same_v<typename Head::kind, Kind>, std::type_identity<Head>, find_option<Kind, Default, Options...>> {};
+
+        template <typename Kind, typename Default, typename...Options>
+        using find_option_t = typename find_option<Kind, Default, Options...>::type;
+
+        // tests for find_option_t
+        template <typename T> struct test_option : option<test_option<void>> {};
+        struct other_option : option<other_option> {};
+        static_assert(std::is_same_v<find_option_t<test_option<void>, void, other_option, test_option<bool>, test_option<int>>, test_option<bool>>);
+        static_assert(std::is_same_v<find_option_t<test_option<void>, void, other_option>, void>);
+        static_assert(std::is_same_v<find_option_t<test_option<void>, void>, void>);
+
+        // the default action of StateMachine::transitionTo
+        struct no_action
+        {
+            constexpr void operator()() const {}
+        };
+
+        // storage of the current state id as a data member of StateMachine
+        template <typename Id>
+        struct inline_state_id
+        {
+            Id m_currentState{};
+        };
+
+        // the current state id is stored by a user policy, outside of StateMachine
+        struct no_state_id {};
+
+        // a circular buffer of up to Capacity events of types Events..., stored inline
+        template <size_t Capacity, typename...Events>
+        class event_queue
+        {
+            using variant_t = std::variant<std::monostate, Events...>;
+
+            std::array<variant_t, Capacity> m_events{};
+            size_t m_head = 0;
+            size_t m_size = 0;
+
+        public:
+            bool m_draining = false;
+            size_t m_dropped = 0;   // events not queued because the queue was full
+
+            constexpr size_t size() const { return m_size; }
+
+            // with an allocator, the event is copied with uses-allocator construction
+            template <typename Event, typename...Alloc>
+            constexpr bool push(const Event& ev, const Alloc&...alloc)
+            {
+                if (m_size == Capacity) {
+                    ++m_dropped;
+                    return false;
+                }
+                if constexpr (sizeof...(Alloc) > 0)
+                    m_events[(m_head + m_size) % Capacity].template emplace<Event>(std::make_obj_using_allocator<Event>(alloc..., ev));
+                else
+                    m_events[(m_head + m_size) % Capacity].template emplace<Event>(ev);
+                ++m_size;
+                return true;
+            }
+
+            // removes the oldest event and returns it
+            constexpr variant_t pop()
+            {
+                variant_t ev = std::move(m_events[m_head]);
+                m_head = (m_head + 1) % Capacity;
+                --m_size;
+                return ev;
+            }
+        };
+
+        struct no_event_queue {};
+
+        // the coroutine of the handler in flight, and the arena in which its frame is allocated, stored inline
+        template <size_t FrameBytes>
+        struct async_slot
+        {
+            alignas(std::max_align_t) std::array<std::byte, FrameBytes> m_frame;
+            bool m_frameInUse = false;
+            std::coroutine_handle<> m_inFlight;
+        };
+
+        struct no_async_slot {};
+
+        // the timer wheel to which the state machine is attached, and the id of its timer in the wheel
+        template <typename Wheel>
+        struct timeout_slot
+        {
+            Wheel* m_wheel = nullptr;
+            uint32_t m_timer = 0;
+        };
+
+        struct no_timeout_slot {};
+
+        // the timeout of State, in ticks of the timer wheel, i.e. State::timeout
+        template <typename State>
+        inline constexpr bool has_timeout_v = requires { { State::timeout } -> std::convertible_to<uint64_t>; };
+
+        struct no_allocator {};
+
+        // the state at position I in the list of states of tuple_states
+        template <size_t I, typename State>
+        struct state_slot
+        {
+            [[no_unique_address]] State m_state;
+
+            constexpr state_slot() : m_state() {}
+
+            template <typename Alloc>
+            constexpr state_slot(std::allocator_arg_t, const Alloc& alloc) : m_state(std::make_obj_using_allocator<State>(alloc)) {}
+        };
+
+        template <typename Seq, typename...States>
+        class tuple_states_impl;
+
+        // all states are constructed with the state machine, and live as long as it
+        // States are bases of the class, rather than elements of a std::tuple, whose recursive implementation
+        // exceeds the maximum template depth of the compiler with about a thousand states.
+        template <size_t...Is, typename...States>
+        class tuple_states_impl<std::index_sequence<Is...>, States...> : state_slot<Is, States>...
+        {
+            template <typename State, size_t I>
+            static constexpr state_slot<I, State>& slot(state_slot<I, State>& s) { return s; }
+
+            template <typename State, size_t I>
+            static constexpr const state_slot<I, State>& slot(const state_slot<I, State>& s) { return s; }
+
+        public:
+            static constexpr bool s_allAlive = true;
+
+            tuple_states_impl() = default;
+
+            // each state is constructed with uses-allocator construction
+            template <typename Alloc>
+            constexpr tuple_states_impl(std::allocator_arg_t, const Alloc& alloc) : state_slot<Is, States>(std::allocator_arg, alloc)... {}
+
+            template <typename State>
+            constexpr State& get() { return slot<State>(*this).m_state; }
+
+            template <typename State>
+            constexpr const State& get() const { return slot<State>(*this).m_state; }
+
+            template <typename State, typename...Alloc>
+            constexpr void emplace(const Alloc&...) {}
+        };
+
+        template <typename...States>
+        using tuple_states = tuple_states_impl<std::index_sequence_for<States...>, States...>;
+
+        // only the current state is alive, in a buffer large enough for the largest state
+        // The first state is constructed with the state machine, as the state id is initially 0.
+        template <typename...States>
+        class union_states
+        {
+            using index_t = uint_for_t<sizeof...(States)>;
+
+            template <typename State>
+            static constexpr index_t s_index = index_t(index_in_tuple_v<State, std::tuple<States...>>);
+
+            using first_t = type_at_t<0, States...>;
+
+            // one function per state, selected by the index of the state which is alive
+            static constexpr std::array<void (*)(void*), sizeof...(States)> s_destroy =
+                { [](void* p) { static_cast<States*>(p)->~States(); }... };
+            static constexpr std::array<void (*)(void*, const void*), sizeof...(States)> s_copy =
+                { [](void* dst, const void* src) { ::new (dst) States(*static_cast<const States*>(src)); }... };
+            static constexpr std::array<void (*)(void*, void*), sizeof...(States)> s_move =
+                { [](void* dst, void* src) { ::new (dst) States(std::move(*static_cast<States*>(src))); }... };
+
+            alignas(States...) std::byte m_buffer[std::max({ sizeof(States)... })];
+            index_t m_index = 0;  // the state which is alive, tracked here as the state id can be stored outside
+
+            void destroy()
+            {
+                if constexpr (!(true && ... && std::is_trivially_destructible_v<States>))
+                    s_destroy[m_index](m_buffer);
+            }
+
+        public:
+            static constexpr bool s_allAlive = false;
+
+            union_states() { ::new (m_buffer) first_t(); }
+            template <typename Alloc>
+            union_states(std::allocator_arg_t, const Alloc& alloc) { std::uninitialized_construct_using_allocator(reinterpret_cast<first_t*>(m_buffer), alloc); }
+            union_states(const union_states& rhs) : m_index(rhs.m_index) { s_copy[m_index](m_buffer, rhs.m_buffer); }
+            union_states(union_states&& rhs) : m_index(rhs.m_index) { s_move[m_index](m_buffer, rhs.m_buffer); }
+            ~union_states() { destroy(); }
+
+            union_states& operator=(const union_states& rhs)
+            {
+                if (this != &rhs) {
+                    destroy();
+                    m_index = rhs.m_index;
+                    s_copy[m_index](m_buffer, rhs.m_buffer);
+                }
+                return *this;
+            }
+
+            union_states& operator=(union_states&& rhs)
+            {
+                if (this != &rhs) {
+                    destroy();
+                    m_index = rhs.m_index;
+                    s_move[m_index](m_buffer, rhs.m_buffer);
+                }
+                return *this;
+            }
+
+            // State must be alive
+            template <typename State>
+            State& get() { return *std::launder(reinterpret_cast<State*>(m_buffer)); }
+
+            template <typename State>
+            const State& get() const { return *std::launder(reinterpret_cast<const State*>(m_buffer)); }
+
+            // destroys the state which is alive and constructs State, with uses-allocator construction if an allocator is given
+            // If the constructor of State throws, there would be no state alive, hence std::terminate is invoked
+            template <typename State, typename...Alloc>
+            void emplace(const Alloc&...alloc) noexcept
+            {
+                destroy();
+                if constexpr (sizeof...(Alloc) > 0)
+                    std::uninitialized_construct_using_allocator(reinterpret_cast<State*>(m_buffer), alloc...);
+                else
+                    ::new (m_buffer) State();
+                m_index = s_index<State>;
+            }
+        };
+
+        // grants the other components of the library (e.g. StateMachinePool)
+        // access to the internals of a StateMachine
+        struct fsm_access;
+
     } // namespace details
 
+    // Option of StateMachine: the current state id is stored by Policy, instead of by StateMachine.
+    // This allows, for instance, to pack the state id into spare bits of a data member of the derived class.
+    // Policy must implement the static functions:
+    //     static auto load(const FSM&);            // returns the current state id
+    //     static void store(FSM&, state_id_t id);  // sets the current state id
+    template <typename Policy>
+    struct StateIdStorage : details::option<StateIdStorage<void>> { using policy = Policy; };
+
+    // Policies for the option StateStorage
+    //     TupleStorage: all states are data members of the state machine, constructed with it (default)
+    //     UnionStorage: only the current state is alive, in storage sized for the largest state.
+    //                   It is constructed by enterState and destroyed when leaving it.
+    struct TupleStorage
+    {
+        template <typename...States>
+        using type = details::tuple_states<States...>;
+    };
+
+    struct UnionStorage
+    {
+        template <typename...States>
+        using type = details::union_states<States...>;
+    };
+
+    // Option of StateMachine: how states are stored, either TupleStorage (default) or UnionStorage
+    template <typename Policy>
+    struct StateStorage : details::option<StateStorage<void>> { using policy = Policy; };
+
+    // A transition from state From to state To, triggered by Event.
+    // If Guard is not void, the transition is taken only if Guard{}(const FSM&, const Event&) returns true.
+    // If Action is not void, Action{}(FSM&, const Event&) is invoked after From::exit and before entering To.
+    // Guard and Action can be, for instance, types of captureless lambdas.
+    template <typename From, typename Event, typename To, typename Guard = void, typename Action = void>
+    struct Transition
+    {
+        using from_t = From;
+        using event_t = Event;
+        using to_t = To;
+        using guard_t = Guard;
+        using action_t = Action;
+    };
+
+    // Option of StateMachine: a declarative list of Transition<...>.
+    // When a state has multiple transitions for the same event, their guards are evaluated in the
+    // order the transitions are listed, and the first transition whose guard passes is taken.
+    // If the transitions only change the current state id (no actions, no exit, no enter, no tracer hooks on entering,
+    // all states alive), all guards are evaluated and the new state id is selected without branches.
+    // A state cannot have both a transition and a handler for the same event.
+    template <typename...Transitions>
+    struct TransitionTable : details::option<TransitionTable<>>
+    {
+        // the transitions triggered by Event in state State, in the order they are listed
+        template <typename State, typename Event>
+        using transitions_t = decltype((details::type_list<>{} + ... +
+            std::conditional_t<std::is_same_v<State, typename Transitions::from_t> && std::is_same_v<Event, typename Transitions::event_t>,
+                details::type_list<Transitions>, details::type_list<>>{}));
+
+        // the target states of the transitions from State, for any event
+        template <typename State>
+        using targets_t = decltype((details::type_list<>{} + ... +
+            std::conditional_t<std::is_same_v<State, typename Transitions::from_t>, details::type_list<typename Transitions::to_t>, details::type_list<>>{}));
+
+        using list_t = details::type_list<Transitions...>;
+    };
+
+    // The default tracer, which does nothing
+    struct NullTracer {};
+
+    // Option of StateMachine: an instance of T is a data member of StateMachine and is notified of events and transitions.
+    // T can implement any of the following hooks, which are invoked only if they exist:
+    //     template <typename State, typename FSM, typename Event>
+    //     void onEvent(const FSM&, const Event&);       // State is about to handle Event
+    //     template <typename State, typename FSM, typename Event>
+    //     void onHandled(const FSM&, const Event&);     // State has handled Event
+    //     template <typename State, typename FSM, typename Event>
+    //     void onUnhandled(const FSM&, const Event&);   // State has no handler for Event
+    //     template <typename To, typename FSM>
+    //     void onEnter(const FSM&, unsigned from);       // the state is changing from the state with id 'from' to To
+    //     template <typename To, typename FSM>
+    //     void onEntered(const FSM&);                    // To::enter has returned
+    //     template <typename FSM, typename Event>
+    //     void onPost(const FSM&, const Event&);         // Event was added to the EventQueue by post
+    //     template <typename FSM>
+    //     void onDrain(const FSM&);                      // drain is about to process the EventQueue
+    //     template <typename FSM>
+    //     void onDrained(const FSM&);                    // drain has returned
+    // If onEvent (onEnter) returns a value, the value is passed as an additional last argument to onHandled (onEntered),
+    // e.g. to measure the time spent in the handler.
+    // Implementing onEvent, onHandled or onUnhandled may force process to use a switch, as the hook needs to know the current state.
+    template <typename T>
+    struct Tracer : details::option<Tracer<void>> { using type = T; };
+
+    // Option of StateMachine: a queue of up to Capacity events of types Events..., stored inline in the state machine.
+    // Events are added to the queue with post and processed, in order, with drain. Handlers can post events
+    // which are processed after the handler returns, in the same drain loop (run to completion).
+    template <size_t Capacity, typename...Events>
+    struct EventQueue : details::option<EventQueue<0>>
+    {
+        static_assert(Capacity > 0, "the capacity of the queue must be positive");
+        static_assert(details::are_distinct_v<Events...>, "event types must be distinct");
+        using type = details::event_queue<Capacity, Events...>;
+
+        template <typename Event>
+        static constexpr bool accepts_v = details::elem_in_list_v<Event, Events...>;
+    };
+
+    // Option of StateMachine: handlers can be coroutines returning Task, which co_await e.g. the completion of I/O.
+    // While a handler is suspended, process and processBatch queue further events in the EventQueue (which is
+    // required, and must accept all events processed), and the queued events are processed when the handler completes.
+    // If the queue is full, the event is dropped: processRaw returns false, and droppedEvents counts the events dropped.
+    // The frame of the coroutine is allocated in an arena of FrameBytes bytes stored in the state machine,
+    // or on the heap if it does not fit.
+    template <size_t FrameBytes = 256>
+    struct AsyncHandlers : details::option<AsyncHandlers<0>> { using type = details::async_slot<FrameBytes>; };
+
+    // Option of StateMachine: states can declare a timeout, in ticks of a timer wheel of type Wheel
+    // (e.g. TimerWheel, in tiniestfsm_timer.h), as
+    //     struct Connecting { static constexpr uint64_t timeout = 500; ... };
+    // Once the state machine is attached to a wheel with attachTimer, entering a state arms its timeout (if it has one),
+    // and leaving it cancels the timeout. When a timeout expires, the wheel delivers a TimeoutEvent, which the state
+    // can handle like any other event.
+    // Wheel must implement:
+    //     void arm(uint32_t timer, uint64_t ticks, unsigned state);  // (re)starts the timer
+    //     void cancel(uint32_t timer);                               // stops the timer, if it is running
+    template <typename Wheel>
+    struct Timeouts : details::option<Timeouts<void>> { using type = details::timeout_slot<Wheel>; };
+
+    // Option of StateMachine: states are constructed with an allocator of type Alloc (e.g. std::pmr::polymorphic_allocator<>),
+    // passed to the constructor of the state machine, with uses-allocator construction: states which use the allocator
+    // (e.g. have members of type std::pmr::vector) receive it, the others are default constructed.
+    // The events queued in the EventQueue are also copied with the allocator.
+    template <typename Alloc>
+    struct Allocator : details::option<Allocator<void>> { using type = Alloc; };
+
+    // Option of StateMachine: the list of all event types, each identified by its index in Events...
+    // Enables processRaw, for events whose type is known only at run time (e.g. decoded from a tag).
+    template <typename...Events>
+    struct EventTypes : details::option<EventTypes<>>
+    {
+        static_assert(details::are_distinct_v<Events...>, "event types must be distinct");
+    };
+
+    // Option of StateMachine: the states which are the current state most of the time, in decreasing order of frequency.
+    // When process needs a switch, or a table, to dispatch an event, it first compares the current state with each
+    // of these states, as a likely branch. The handlers of these states called via the table are marked as hot,
+    // so that the compiler can group them. State ids do not change.
+    template <typename...States>
+    struct HotStates : details::option<HotStates<>>
+    {
+        static_assert(details::are_distinct_v<States...>, "hot states must be distinct");
+        using states_t = std::tuple<States...>;
+    };
+
+    // Option of StateMachine: the states which can be entered from outside the state machine, e.g. by calling
+    // enterState on a new instance. The first state, which is the current state on construction, is implicitly included.
+    // States which cannot be reached from these are dead: they are dropped from the dispatch of all events, so process
+    // ignores events in those states, and their handlers are not even compiled.
+    // A state is reached from the current state State by the transitions of State (and of its ancestors) in the TransitionTable,
+    // and by the states listed in State::targets, e.g.:
+    //     struct Open { using targets = std::tuple<Closed>; ... };  // the states which its handlers, enter and exit can enter
+    // A state which does not declare targets, and has handlers, enter or exit, can reach any state. Handlers are known only
+    // with the option EventTypes: without it, all states without targets are assumed to have handlers.
+    template <typename...States>
+    struct ReachableFrom : details::option<ReachableFrom<>> { using states_t = std::tuple<States...>; };
+
+    // The strategy used by StateMachine::process to dispatch an event to the current state
+    enum class DispatchStrategy
+    {
+        None,     // no state handles the event: process does nothing
+        Single,   // only one state handles the event: a single comparison with the current state id
+        Uniform,  // all states handle the event with the same static handler: the handler is called unconditionally
+        Switch,        // a switch on the current state id
+        Table,         // an indexed call through a table of function pointers (more than 256 states, or JumpTableDispatch)
+        ComputedGoto,  // a jump through a table of labels indexed by the current state id (ComputedGotoDispatch)
+        IfChain,       // a comparison with each state which handles the event, in order (IfChainDispatch)
+        BinarySearch   // a binary search among the states which handle the event (BinarySearchDispatch)
+    };
+
+    // Policies for the option DispatchPolicy, i.e. how process dispatches an event which more than one state handles
+    //     AutoDispatch: a switch with up to 256 states, otherwise a table of function pointers (default)
+    //     SwitchDispatch: a switch, which compilers usually compile to a jump table (up to 256 states)
+    //     JumpTableDispatch: an indexed call through a table of function pointers
+    //     ComputedGotoDispatch: an indexed jump through a table of labels (up to 256 states). This is a GCC and clang
+    //                           extension: with other compilers, it is a switch.
+    //     IfChainDispatch: a comparison with each state which handles the event, in order of id (after the states
+    //                      in HotStates). This has no table and is the smallest code for a few states, e.g. on microcontrollers.
+    //     BinarySearchDispatch: a binary search among the states which handle the event. This has no table and
+    //                           is the best choice when only a few of many states handle the event.
+    struct AutoDispatch {};
+    struct SwitchDispatch {};
+    struct JumpTableDispatch {};
+    struct ComputedGotoDispatch {};
+    struct IfChainDispatch {};
+    struct BinarySearchDispatch {};
+
+    // Option of StateMachine: how events are dispatched to the current state, one of the policies above.
+    // Events which no state, only one state, or all states with the same static handler handle are always dispatched
+    // with the strategies None, Single and Uniform.
+    template <typename Policy>
+    struct DispatchPolicy : details::option<DispatchPolicy<void>> { using policy = Policy; };
+
     template <typename...Ts>
     class StateMachine;
 
-    template <typename DerivedClass, typename...States>
+    template <typename DerivedClass, typename...States, typename...Options>
         requires
             ( details::are_distinct_v<States...>   // states must be distinct types
-            && std::conjunction_v<std::is_class<States>...>    // states must be classes
+            && (true && ... && std::is_class_v<States>)    // states must be classes
             && (sizeof...(States) > 0)
+            && (true && ... && std::is_base_of_v<details::option_tag, Options>)    // options must be valid
             )
     // The first argument is the class itself, the second argument is a tuple with all possible states
     // The tuple of states is intantiated as a data member of the base class.
     // States types must be unique and must be classes
-    class StateMachine<DerivedClass, std::tuple<States...>>
+    // The following arguments are optional and customize the behaviour of the state machine (e.g. StateIdStorage<Policy>)
+    class StateMachine<DerivedClass, std::tuple<States...>, Options...>
     {
+        friend struct details::fsm_access;
+
         // *****************************
         // constants
         //
@@ -106,15 +874,83 @@ namespace tiniest_fsm {
         //
 
 
-        using this_t = StateMachine<DerivedClass, std::tuple<States...>>;
+        using this_t = StateMachine<DerivedClass, std::tuple<States...>, Options...>;
         using FSM = DerivedClass;
+        using states_t = std::tuple<States...>;
+
+        using id_storage_policy_t = typename details::find_option_t<StateIdStorage<void>, StateIdStorage<void>, Options...>::policy;
+
+        static constexpr bool s_userIdStorage = !std::is_void_v<id_storage_policy_t>;
+
+        using transition_table_t = details::find_option_t<TransitionTable<>, TransitionTable<>, Options...>;
+
+        using tracer_t = typename details::find_option_t<Tracer<void>, Tracer<NullTracer>, Options...>::type;
+
+        using state_storage_t = typename details::find_option_t<StateStorage<void>, StateStorage<TupleStorage>, Options...>::policy::template type<States...>;
+
+        using event_queue_option_t = details::find_option_t<EventQueue<0>, void, Options...>;
+        static constexpr bool s_hasEventQueue = !std::is_void_v<event_queue_option_t>;
+
+        template <typename Option>
+        struct event_queue_of { using type = details::no_event_queue; };
+
+        template <typename Option> requires (!std::is_void_v<Option>)
+        struct event_queue_of<Option> { using type = typename Option::type; };
+
+        using allocator_option_t = typename details::find_option_t<Allocator<void>, Allocator<void>, Options...>::type;
+        static constexpr bool s_hasAllocator = !std::is_void_v<allocator_option_t>;
+        using allocator_storage_t = std::conditional_t<s_hasAllocator, allocator_option_t, details::no_allocator>;
+
+        using event_types_option_t = details::find_option_t<EventTypes<>, void, Options...>;
+        static constexpr bool s_hasEventTypes = !std::is_void_v<event_types_option_t>;
+
+        using async_option_t = details::find_option_t<AsyncHandlers<0>, void, Options...>;
+        static constexpr bool s_hasAsyncHandlers = !std::is_void_v<async_option_t>;
+
+        static_assert(!s_hasAsyncHandlers || s_hasEventQueue, "the option AsyncHandlers requires the option EventQueue");
+
+        template <typename Option>
+        struct async_slot_of { using type = details::no_async_slot; };
+
+        template <typename Option> requires (!std::is_void_v<Option>)
+        struct async_slot_of<Option> { using type = typename Option::type; };
+
+        using timeouts_option_t = details::find_option_t<Timeouts<void>, void, Options...>;
+        static constexpr bool s_hasTimeouts = !std::is_void_v<timeouts_option_t>;
+        using timeout_slot_t = typename std::conditional_t<s_hasTimeouts, timeouts_option_t, std::type_identity<details::no_timeout_slot>>::type;
+
+        static constexpr uint64_t s_noTimeout = uint64_t(-1);
+
+        // the timeout of each state, or s_noTimeout
+        static constexpr std::array<uint64_t, s_nStates> s_timeouts = { [] {
+            if constexpr (details::has_timeout_v<States>)
+                return uint64_t(States::timeout);
+            else
+                return s_noTimeout;
+        }()... };
+
+        // a handler for an event of type Event
+        template <typename Event>
+        using event_handler_t = bool (*)(this_t&, const Event&);
+
+    public:
+
+        // the smallest unsigned type which can represent all state ids
+        using state_id_t = details::uint_for_t<s_nStates>;
+
+    private:
 
         // *****************************
         // data members
         //
 
-        unsigned m_currentState;
-        [[no_unique_address]] std::tuple<States...> m_states;
+        [[no_unique_address]] std::conditional_t<s_userIdStorage, details::no_state_id, details::inline_state_id<state_id_t>> m_id;
+        [[no_unique_address]] allocator_storage_t m_alloc;  // before m_states, which is constructed with it
+        [[no_unique_address]] state_storage_t m_states;
+        [[no_unique_address]] tracer_t m_tracer;
+        [[no_unique_address]] typename event_queue_of<event_queue_option_t>::type m_queue;
+        [[no_unique_address]] typename async_slot_of<async_option_t>::type m_async;
+        [[no_unique_address]] timeout_slot_t m_timeouts;
 
         // *****************************
         // auxiliary functions
@@ -124,94 +960,1317 @@ namespace tiniest_fsm {
         static constexpr bool valid_state_v = details::elem_in_list_v<State, States...>;
 
         template <typename State, typename Event>
-        static constexpr bool has_handler_v = requires (State && s, const Event & ev) { s.handle((FSM*)nullptr, ev); };
+        static constexpr bool has_handler_v = details::has_handler_v<FSM, State, Event>;
+
+        template <typename State, typename Event>
+        using transitions_t = typename transition_table_t::template transitions_t<State, Event>;
+
+        template <typename State, typename Event>
+        static constexpr bool has_transition_v = details::has_transition_v<transition_table_t, State, Event>;
+
+        // the state which handles Event when the current state is State, or void
+        template <typename State, typename Event>
+        using handling_state_t = details::handling_state_t<FSM, transition_table_t, State, Event>;
+
+        // true if Event is handled when the current state is State
+        template <typename State, typename Event>
+        static constexpr bool is_handled_v = !std::is_void_v<handling_state_t<State, Event>>;
 
-        FSM* fsm() { return (FSM*)this; }
+        template <typename State, typename Event>
+        static constexpr bool traces_event_v = details::traces_event_v<tracer_t, FSM, State, Event>;
+
+        template <typename State, typename Event>
+        static constexpr bool traces_unhandled_v = details::traces_unhandled_v<tracer_t, FSM, State, Event>;
 
         template <typename State>
-        static consteval size_t getStateIndex()
-        {
-            static_assert(valid_state_v<State>, "invalid state type");
-            constexpr std::array<bool, s_nStates> isIt = { std::is_same_v<State,States>... };
-            return std::distance(isIt.begin(), std::ranges::find(isIt, true));
-        }
+        static constexpr bool traces_enter_v = details::traces_enter_v<tracer_t, FSM, State>;
+
+        template <typename State>
+        static constexpr bool traces_entered_v = details::traces_entered_v<tracer_t, FSM, State>;
+
+        template <typename Event>
+        using static_handler_t = void (*)(FSM*, const Event&);
 
+        // the address of the handler of Event in the current state State, if the handler is a static member function, or nullptr
         template <typename State, typename Event>
-        void processFromState(const Event& ev)
-        {
-            if constexpr (has_handler_v<State, Event>)
-                std::get<State>(m_states).handle(fsm(), ev);
-        }
+        static constexpr static_handler_t<Event> static_handler_v = details::static_handler_v<FSM, transition_table_t, State, Event>;
 
-        template <uint16_t StateIndex, typename Event>
-        void processFromIndex(const Event& ev)
-        {
-            static_assert(StateIndex < sizeof...(States), "invalid state index");
-            using State = std::tuple_element_t<StateIndex, std::tuple<States...>>;
-            processFromState<State>(ev);
-        }
+        // *****************************
+        // reachability, with the option ReachableFrom
+        //
 
-    public:
+        using reachable_option_t = details::find_option_t<ReachableFrom<>, void, Options...>;
+
+        using hot_states_t = typename details::find_option_t<HotStates<>, HotStates<>, Options...>::states_t;
+
+        using dispatch_policy_t = typename details::find_option_t<DispatchPolicy<void>, DispatchPolicy<AutoDispatch>, Options...>::policy;
+
+        template <typename State>
+        static constexpr bool is_hot_v = details::index_in_tuple_v<State, hot_states_t> < std::tuple_size_v<hot_states_t>;
+
+        template <typename EventList>
+        struct handles_any;
 
-        unsigned currentStateId() const
+        template <typename...Events>
+        struct handles_any<EventTypes<Events...>>
         {
-            return m_currentState;
-        }
+            template <typename State>
+            static constexpr bool value = (false || ... || has_handler_v<State, Events>);
+        };
 
+        // true if the handlers, enter or exit of State may enter any state
         template <typename State>
-        State& getState()
+        static constexpr bool enters_any_v = [] {
+            if constexpr (!std::is_void_v<typename details::declared_targets<State>::type>)
+                return false;
+            else if constexpr (requires (State & s) { s.enter((FSM*)nullptr); } || requires (State & s) { s.exit((FSM*)nullptr); })
+                return true;
+            else if constexpr (s_hasEventTypes)
+                return handles_any<event_types_option_t>::template value<State>;
+            else
+                return true;
+        }();
+
+        template <typename...Ts>
+        static constexpr void markStates(std::array<bool, s_nStates>& row, details::type_list<Ts...>)
         {
-            static_assert(valid_state_v<State>, "invalid state type");
-            return std::get<State>(m_states);
+            static_assert((true && ... && valid_state_v<Ts>), "the target of a transition is not a valid state");
+            ((row[details::index_in_tuple_v<Ts, states_t>] = true), ...);
         }
 
-        template <typename State>
-        const State& getState() const
+        template <typename...Ts>
+        static constexpr void markStates(std::array<bool, s_nStates>& row, std::tuple<Ts...>*)
         {
-            static_assert(valid_state_v<State>, "invalid state type");
-            return std::get<State>(m_states);
+            markStates(row, details::type_list<Ts...>{});
+        }
+
+        // marks the states which can be entered when the current state is State
+        template <typename State>
+        static constexpr void markTargets(std::array<bool, s_nStates>& row)
+        {
+            if constexpr (!std::is_void_v<State>) {
+                markStates(row, typename transition_table_t::template targets_t<State>{});
+                if constexpr (!std::is_void_v<typename details::declared_targets<State>::type>)
+                    markStates(row, (typename details::declared_targets<State>::type*)nullptr);
+                if constexpr (enters_any_v<State>)
+                    row.fill(true);
+                markTargets<details::parent_of_t<State>>(row);
+            }
+        }
+
+        // the states which can become the current state (all of them, without the option ReachableFrom)
+        static constexpr std::array<bool, s_nStates> s_reachable = [] {
+            std::array<bool, s_nStates> reached{};
+            if constexpr (std::is_void_v<reachable_option_t>)
+                reached.fill(true);
+            else {
+                constexpr std::array<void (*)(std::array<bool, s_nStates>&), s_nStates> targets = { &markTargets<States>... };
+                std::array<size_t, s_nStates> pending{};  // states reached but not visited yet
+                size_t nPending = 0;
+                std::array<bool, s_nStates> roots{};
+                roots[0] = true;
+                markStates(roots, (typename reachable_option_t::states_t*)nullptr);
+                for (size_t i = 0; i < s_nStates; ++i)
+                    if (roots[i]) {
+                        reached[i] = true;
+                        pending[nPending++] = i;
+                    }
+                while (nPending > 0) {
+                    std::array<bool, s_nStates> row{};
+                    targets[pending[--nPending]](row);
+                    for (size_t i = 0; i < s_nStates; ++i)
+                        if (row[i] && !reached[i]) {
+                            reached[i] = true;
+                            pending[nPending++] = i;
+                        }
+                }
+            }
+            return reached;
+        }();
+
+        template <typename State>
+        static constexpr bool is_reachable_v = s_reachable[details::index_in_tuple_v<State, states_t>];
+
+        // The following properties of all states are computed once per event, in arrays indexed by state id, from traits
+        // at namespace scope. Evaluating a member template once per state would take time quadratic in the number of states.
+
+        // true for the states in which Event is dispatched, i.e. which are reachable and handle Event
+        template <typename Event>
+        static constexpr std::array<bool, s_nStates> s_dispatched = [] {
+            std::array<bool, s_nStates> dispatched = { !std::is_void_v<details::handling_state_t<FSM, transition_table_t, States, Event>>... };
+            for (size_t i = 0; i < s_nStates; ++i)
+                dispatched[i] = dispatched[i] && s_reachable[i];
+            return dispatched;
+        }();
+
+        // true if Event is dispatched when the current state is State
+        template <typename State, typename Event>
+        static constexpr bool is_dispatched_v = s_dispatched<Event>[details::index_in_tuple_v<State, states_t>];
+
+        // number of states which handle Event
+        template <typename Event>
+        static constexpr size_t s_nHandlingStates = size_t(std::ranges::count(s_dispatched<Event>, true));
+
+        // if only one state handles Event, this is its index
+        template <typename Event>
+        static constexpr size_t s_singleHandlingState = size_t(std::ranges::find(s_dispatched<Event>, true) - s_dispatched<Event>.begin());
+
+        // true for the states for which dispatch must call processFromState, i.e. which are not hot states and
+        // either handle Event or notify the tracer that they do not
+        template <typename Event>
+        static constexpr std::array<bool, s_nStates> s_searched = [] {
+            constexpr std::array<bool, s_nStates> hot = { (details::index_in_tuple_v<States, hot_states_t> < std::tuple_size_v<hot_states_t>)... };
+            constexpr std::array<bool, s_nStates> tracesUnhandled = { details::traces_unhandled_v<tracer_t, FSM, States, Event>... };
+            std::array<bool, s_nStates> searched{};
+            for (size_t i = 0; i < s_nStates; ++i)
+                searched[i] = !hot[i] && (s_dispatched<Event>[i] || (s_reachable[i] && tracesUnhandled[i]));
+            return searched;
+        }();
+
+        // the ids of the states for which s_searched is true, in increasing order, for IfChain and BinarySearch
+        template <typename Event>
+        static constexpr auto s_searchedStates = [] {
+            constexpr auto& searched = s_searched<Event>;
+            std::array<size_t, std::ranges::count(searched, true)> ids{};
+            size_t n = 0;
+            for (size_t i = 0; i < s_nStates; ++i)
+                if (searched[i])
+                    ids[n++] = i;
+            return ids;
+        }();
+
+        // true if all reachable states handle Event with the same static member function
+        template <typename Event>
+        static constexpr bool s_uniformHandler = [] {
+            constexpr std::array<static_handler_t<Event>, s_nStates> handlers = { details::static_handler_v<FSM, transition_table_t, States, Event>... };
+            for (size_t i = 0; i < s_nStates; ++i)
+                if (s_reachable[i] && handlers[i] != handlers[0])
+                    return false;
+            return handlers[0] != nullptr;
+        }();
+
+        static_assert((true && ... && (std::is_void_v<details::parent_of_t<States>> || valid_state_v<details::parent_of_t<States>>)),
+            "the parent of a state must be one of the states");
+
+        constexpr FSM* fsm() { return (FSM*)this; }
+        constexpr const FSM* fsm() const { return (const FSM*)this; }
+
+        constexpr state_id_t stateId() const
+        {
+            if constexpr (s_userIdStorage)
+                return static_cast<state_id_t>(id_storage_policy_t::load(*fsm()));
+            else
+                return m_id.m_currentState;
+        }
+
+        constexpr void setStateId(state_id_t id)
+        {
+            if constexpr (s_userIdStorage)
+                id_storage_policy_t::store(*fsm(), id);
+            else
+                m_id.m_currentState = id;
+        }
+
+        template <typename State>
+        static consteval size_t getStateIndex()
+        {
+            static_assert(valid_state_v<State>, "invalid state type");
+            return details::index_in_tuple_v<State, states_t>;
+        }
+
+        // true if the guard of the transition T passes
+        template <typename T, typename Event>
+        constexpr bool guardPasses(const Event& ev) const
+        {
+            using guard_t = typename T::guard_t;
+            if constexpr (std::is_void_v<guard_t>)
+                return true;
+            else
+                return bool(guard_t{}(*fsm(), ev));
+        }
+
+        // true if taking the transition T from the current state State only changes the current state id:
+        // there is no action, no State::exit, no To::enter, no tracer hook, and states are always alive
+        template <typename State, typename T>
+        static constexpr bool is_trivial_transition_v = std::is_void_v<typename T::action_t>
+            && state_storage_t::s_allAlive
+            && !s_hasTimeouts
+            && !requires (State & s, FSM * f) { s.exit(f); }
+            && !requires (typename T::to_t & s, FSM * f) { s.enter(f); }
+            && !traces_enter_v<typename T::to_t>
+            && !traces_entered_v<typename T::to_t>;
+
+        template <typename State, typename...Ts>
+        static consteval bool isBranchless(details::type_list<Ts...>)
+        {
+            return (sizeof...(Ts) > 0) && (true && ... && is_trivial_transition_v<State, Ts>);
+        }
+
+        // true if all transitions in the type_list List, from the current state State, are trivial
+        template <typename State, typename List>
+        static constexpr bool is_branchless_v = isBranchless<State>(List{});
+
+        // The id of the target of the first transition in Ts... whose guard passes, or of State if none passes.
+        // All guards are evaluated, and the id is computed with masks rather than with branches.
+        template <typename State, typename...Ts, typename Event>
+        constexpr state_id_t selectTransition(details::type_list<Ts...>, const Event& ev) const
+        {
+            state_id_t next = state_id_t(getStateIndex<State>());
+            bool taken = false;
+            ([&] {
+                const bool pass = guardPasses<Ts>(ev);
+                const state_id_t mask = state_id_t(state_id_t(0) - state_id_t(pass & !taken));
+                next = state_id_t(next ^ ((next ^ state_id_t(getStateIndex<typename Ts::to_t>())) & mask));
+                taken |= pass;
+            }(), ...);
+            return next;
+        }
+
+        // returns true if the transition T is taken from the current state State
+        template <typename State, typename T, typename Event>
+        constexpr bool tryTransition(const Event& ev)
+        {
+            using action_t = typename T::action_t;
+            if (!guardPasses<T>(ev))
+                return false;
+            if constexpr (!std::is_void_v<action_t>)
+                transitionTo<State, typename T::to_t>([&] { action_t{}(*fsm(), ev); });
+            else
+                transitionTo<State, typename T::to_t>();
+            return true;
+        }
+
+        template <typename State, typename...Ts, typename Event>
+        constexpr void processTransitions(details::type_list<Ts...> transitions, const Event& ev)
+        {
+            if constexpr (is_branchless_v<State, details::type_list<Ts...>>)
+                setStateId(selectTransition<State>(transitions, ev));
+            else
+                (tryTransition<State, Ts>(ev) || ...);
+        }
+
+        // returns true if the current state State, or one of its ancestors, has a handler or a transition for Event
+        template <typename State, typename Event>
+        constexpr bool processFromState(const Event& ev)
+        {
+            using handler_t = handling_state_t<State, Event>;
+            if constexpr (is_handled_v<State, Event>) {
+                static_assert(!(has_handler_v<handler_t, Event> && has_transition_v<handler_t, Event>),
+                    "a state cannot have both a handler and a transition for the same event");
+                details::bracket(
+                    [&] {
+                        if constexpr (traces_event_v<State, Event>)
+                            return m_tracer.template onEvent<State>(*fsm(), ev);
+                    },
+                    [&] {
+                        if constexpr (has_handler_v<handler_t, Event> && (state_storage_t::s_allAlive || std::is_same_v<handler_t, State>))
+                            m_states.template get<handler_t>().handle(fsm(), ev);
+                        else if constexpr (has_handler_v<handler_t, Event>) {
+                            // the ancestor which handles the event is not alive
+                            static_assert(requires { handler_t::handle(fsm(), ev); },
+                                "with UnionStorage, handlers inherited from a parent state must be static");
+                            handler_t::handle(fsm(), ev);
+                        }
+                        else
+                            processTransitions<State>(transitions_t<handler_t, Event>{}, ev);
+                    },
+                    [&](const auto&...token) {
+                        if constexpr (requires { m_tracer.template onHandled<State>(*fsm(), ev, token...); })
+                            m_tracer.template onHandled<State>(*fsm(), ev, token...);
+                    });
+                return true;
+            }
+            else {
+                if constexpr (traces_unhandled_v<State, Event>)
+                    m_tracer.template onUnhandled<State>(*fsm(), ev);
+                return false;
+            }
+        }
+
+        template <typename State, typename Event>
+        static constexpr bool processFromStateOf(this_t& self, const Event& ev)
+        {
+            return self.processFromState<State>(ev);
+        }
+
+        template <typename State, typename Event>
+        _TINIEST_FSM_HOT static constexpr bool processFromHotStateOf(this_t& self, const Event& ev)
+        {
+            return self.processFromState<State>(ev);
+        }
+
+        template <typename State, typename Event>
+        static constexpr event_handler_t<Event> event_handler_v = [] {
+            if constexpr (!is_dispatched_v<State, Event>)
+                return event_handler_t<Event>(nullptr);
+            else if constexpr (is_hot_v<State>)
+                return &processFromHotStateOf<State, Event>;
+            else
+                return &processFromStateOf<State, Event>;
+        }();
+
+        // the handlers of Event for each state, or nullptr if the state does not handle Event
+        // This is the column of Event in the dense [event][state] dispatch table.
+        template <typename Event>
+        static constexpr std::array<event_handler_t<Event>, s_nStates> s_eventHandlers = { event_handler_v<States, Event>... };
+
+        // a handler for an event whose type is known only at run time
+        using raw_handler_t = bool (*)(this_t&, const void*);
+
+        template <typename State, typename Event>
+        static bool processRawFromState(this_t& self, const void* ev)
+        {
+            return self.processFromState<State>(*static_cast<const Event*>(ev));
+        }
+
+        template <typename Event>
+        static bool deliverRaw(this_t& self, const void* ev)
+        {
+            return self.deliver(*static_cast<const Event*>(ev));
+        }
+
+        template <typename EventList>
+        struct raw_dispatch;
+
+        // the dense [event][state] table used by processRaw, for the events in the option EventTypes<Events...>
+        // Entries are nullptr where the state does not handle the event, unless the tracer needs to be notified.
+        template <typename...Events>
+        struct raw_dispatch<EventTypes<Events...>>
+        {
+            static constexpr size_t s_nEvents = sizeof...(Events);
+
+            template <typename Event>
+            static constexpr std::array<raw_handler_t, s_nStates> s_column =
+                { (is_dispatched_v<States, Event> || (is_reachable_v<States> && traces_unhandled_v<States, Event>) ? &processRawFromState<States, Event> : nullptr)... };
+
+            static constexpr std::array<raw_handler_t, s_nEvents * s_nStates> s_table = [] {
+                std::array<raw_handler_t, s_nEvents * s_nStates> table{};
+                size_t e = 0;
+                ((std::ranges::copy(s_column<Events>, table.begin() + s_nStates * e++)), ...);
+                return table;
+            }();
+
+            // used while a coroutine handler is suspended, to queue the event
+            static constexpr std::array<raw_handler_t, s_nEvents> s_deliver = { &deliverRaw<Events>... };
+
+            template <typename Event>
+            static constexpr size_t index_v = details::index_in_tuple_v<Event, std::tuple<Events...>>;
+
+            template <typename Event>
+            static constexpr bool contains_v = details::elem_in_list_v<Event, Events...>;
+        };
+
+        template <size_t StateIndex, typename Event>
+        constexpr bool processFromIndex(const Event& ev)
+        {
+            static_assert(StateIndex < sizeof...(States), "invalid state index");
+            using State = details::type_at_t<StateIndex, States...>;
+            if constexpr (is_hot_v<State>) {
+                // already handled by dispatchHot
+                _TINIEST_FSM_UNREACHABLE;
+                return false;
+            }
+            else if constexpr (is_reachable_v<State>)
+                return processFromState<State>(ev);
+            else
+                return false;
+        }
+
+        // dispatches the event to the current state
+        // returns true if the current state has a handler for Event
+        template <typename Event>
+        constexpr bool dispatch(const Event& ev)
+        {
+            constexpr DispatchStrategy strategy = dispatchStrategy<Event>();
+
+            // to debug this, just put a breakpoint in the function processFromState
+            if constexpr (strategy == DispatchStrategy::None) {
+                return false;
+            }
+            else if constexpr (strategy == DispatchStrategy::Single) {
+                constexpr size_t index = s_singleHandlingState<Event>;
+                if (stateId() != index)
+                    return false;
+                return processFromState<details::tuple_at_t<index, states_t>>(ev);
+            }
+            else if constexpr (strategy == DispatchStrategy::Uniform) {
+                static_handler_v<details::tuple_at_t<0, states_t>, Event>(fsm(), ev);
+                return true;
+            }
+            else {
+                bool handled = false;
+                if (dispatchHot(ev, handled, (hot_states_t*)nullptr))
+                    return handled;
+                if constexpr (strategy == DispatchStrategy::Switch) {
+                    _TINIEST_FSM_SWITCH
+                }
+                else if constexpr (strategy == DispatchStrategy::ComputedGoto) {
+                    // labels cannot be defined in a constexpr function
+                    if (!std::is_constant_evaluated())
+                        return dispatchGoto(ev);
+                    _TINIEST_FSM_SWITCH
+                }
+                else if constexpr (strategy == DispatchStrategy::IfChain) {
+                    return dispatchIfChain(ev, stateId(), std::make_index_sequence<s_searchedStates<Event>.size()>{});
+                }
+                else if constexpr (strategy == DispatchStrategy::BinarySearch) {
+                    return dispatchBinarySearch<0, s_searchedStates<Event>.size()>(ev, stateId());
+                }
+                else {
+                    const event_handler_t<Event> f = s_eventHandlers<Event>[stateId()];
+                    return f && f(*this, ev);
+                }
+            }
+        }
+
+#if defined(_TINIEST_FSM_HAS_COMPUTED_GOTO)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        // labels are per function, so each number of labels needs its own function
+        template <typename Event>
+        bool dispatchGoto(const Event& ev) requires (s_nStates <= 16)
+        {
+            _TINIEST_FSM_GOTO(_TINIEST_FSM_GOTO_16)
+        }
+
+        template <typename Event>
+        bool dispatchGoto(const Event& ev) requires (s_nStates > 16)
+        {
+            _TINIEST_FSM_GOTO(_TINIEST_FSM_GOTO_256)
+        }
+#pragma GCC diagnostic pop
+#endif
+
+        template <typename Event, size_t...Is>
+        constexpr bool dispatchIfChain(const Event& ev, size_t id, std::index_sequence<Is...>)
+        {
+            constexpr auto& ids = s_searchedStates<Event>;
+            bool handled = false;
+            (void)((id == ids[Is] && (handled = processFromState<details::tuple_at_t<ids[Is], states_t>>(ev), true)) || ...);
+            return handled;
+        }
+
+        // searches the current state id among s_searchedStates<Event>[Lo, Hi)
+        template <size_t Lo, size_t Hi, typename Event>
+        constexpr bool dispatchBinarySearch(const Event& ev, size_t id)
+        {
+            constexpr auto& ids = s_searchedStates<Event>;
+            if constexpr (Hi == Lo)
+                return false;
+            else if constexpr (Hi - Lo == 1)
+                return id == ids[Lo] && processFromState<details::tuple_at_t<ids[Lo], states_t>>(ev);
+            else {
+                constexpr size_t mid = (Lo + Hi) / 2;
+                if (id < ids[mid])
+                    return dispatchBinarySearch<Lo, mid>(ev, id);
+                else
+                    return dispatchBinarySearch<mid, Hi>(ev, id);
+            }
+        }
+
+        // if the current state is one of the hot states, dispatches the event to it and returns true
+        template <typename Event, typename Hot, typename...Others>
+        constexpr bool dispatchHot(const Event& ev, bool& handled, std::tuple<Hot, Others...>*)
+        {
+            constexpr size_t index = getStateIndex<Hot>();
+            if (stateId() == index) [[likely]] {
+                if constexpr (is_reachable_v<Hot>)
+                    handled = processFromState<Hot>(ev);
+                return true;
+            }
+            return dispatchHot(ev, handled, (std::tuple<Others...>*)nullptr);
+        }
+
+        template <typename Event>
+        constexpr bool dispatchHot(const Event&, bool&, std::tuple<>*)
+        {
+            return false;
+        }
+
+        // dispatches the event, or queues it if a handler is suspended
+        // Returns false if the event is not handled, or if it is dropped because the queue is full.
+        template <typename Event>
+        constexpr bool deliver(const Event& ev)
+        {
+            if constexpr (s_hasAsyncHandlers) {
+                if (m_async.m_inFlight) {
+                    static_assert(event_queue_option_t::template accepts_v<Event>,
+                        "with AsyncHandlers, the event type must be in the list of the EventQueue option");
+                    return queueEvent(ev);
+                }
+            }
+            return dispatch(ev);
+        }
+
+        template <typename Event>
+        constexpr bool queueEvent(const Event& ev)
+        {
+            if constexpr (s_hasAllocator)
+                return m_queue.push(ev, m_alloc);
+            else
+                return m_queue.push(ev);
+        }
+
+        // invoked by a coroutine handler when it starts (with its handle) and when it completes (with nullptr)
+        void onAsyncHandler(std::coroutine_handle<> h)
+        {
+            m_async.m_inFlight = h;
+            if (!h)
+                drain();
+        }
+
+    public:
+
+        constexpr StateMachine() requires (!s_hasAllocator) = default;
+
+        // with the option Allocator<Alloc>, states are constructed with a default constructed allocator
+        constexpr StateMachine() requires s_hasAllocator
+            : StateMachine(std::allocator_arg, allocator_storage_t())
+        {
+        }
+
+        // Constructs the states with the allocator, with uses-allocator construction.
+        // Requires the option Allocator<Alloc>.
+        constexpr StateMachine(std::allocator_arg_t, const allocator_storage_t& alloc) requires s_hasAllocator
+            : m_alloc(alloc)
+            , m_states(std::allocator_arg, alloc)
+        {
+        }
+
+        // the strategy used by process to dispatch Event
+        template <typename Event>
+        static consteval DispatchStrategy dispatchStrategy()
+        {
+            // the tracer hooks need to know the current state
+            constexpr bool tracesEvent = (false || ... || (details::traces_event_v<tracer_t, FSM, States, Event>
+                                                           || details::traces_handled_v<tracer_t, FSM, States, Event>));
+            constexpr bool tracesUnhandled = (false || ... || details::traces_unhandled_v<tracer_t, FSM, States, Event>);
+            if constexpr (tracesUnhandled)
+                return policyStrategy();
+            else if constexpr (s_nHandlingStates<Event> == 0)
+                return DispatchStrategy::None;
+            else if constexpr (s_nHandlingStates<Event> == 1)
+                return DispatchStrategy::Single;
+            else if constexpr (!tracesEvent && s_uniformHandler<Event>)
+                return DispatchStrategy::Uniform;
+            else
+                return policyStrategy();
+        }
+
+        // the strategy selected by the option DispatchPolicy
+        static consteval DispatchStrategy policyStrategy()
+        {
+            if constexpr (std::is_same_v<dispatch_policy_t, AutoDispatch>)
+                return s_nStates <= 256 ? DispatchStrategy::Switch : DispatchStrategy::Table;
+            else if constexpr (std::is_same_v<dispatch_policy_t, SwitchDispatch>) {
+                static_assert(s_nStates <= 256, "SwitchDispatch supports up to 256 states");
+                return DispatchStrategy::Switch;
+            }
+            else if constexpr (std::is_same_v<dispatch_policy_t, JumpTableDispatch>)
+                return DispatchStrategy::Table;
+            else if constexpr (std::is_same_v<dispatch_policy_t, ComputedGotoDispatch>) {
+                static_assert(s_nStates <= 256, "ComputedGotoDispatch supports up to 256 states");
+#if defined(_TINIEST_FSM_HAS_COMPUTED_GOTO)
+                return DispatchStrategy::ComputedGoto;
+#else
+                return DispatchStrategy::Switch;
+#endif
+            }
+            else if constexpr (std::is_same_v<dispatch_policy_t, IfChainDispatch>)
+                return DispatchStrategy::IfChain;
+            else {
+                static_assert(std::is_same_v<dispatch_policy_t, BinarySearchDispatch>, "invalid dispatch policy");
+                return DispatchStrategy::BinarySearch;
+            }
+        }
+
+        constexpr unsigned currentStateId() const
+        {
+            return stateId();
+        }
+
+        // Returns true if the current state is State or one of its descendants
+        template <typename State>
+        constexpr bool inState() const
+        {
+            static_assert(valid_state_v<State>, "invalid state type");
+            constexpr std::array<bool, s_nStates> descendants = { details::is_ancestor_v<State, States>... };
+            return descendants[stateId()];
+        }
+
+        // Returns the id of State, i.e. the value returned by currentStateId when the current state is State
+        template <typename State>
+        static consteval unsigned stateIndex()
+        {
+            return getStateIndex<State>();
+        }
+
+        // Returns false if State is dead, i.e. cannot be reached from the states in the option ReachableFrom
+        template <typename State>
+        static consteval bool isReachable()
+        {
+            static_assert(valid_state_v<State>, "invalid state type");
+            return is_reachable_v<State>;
+        }
+
+        constexpr tracer_t& tracer()
+        {
+            return m_tracer;
+        }
+
+        constexpr const tracer_t& tracer() const
+        {
+            return m_tracer;
+        }
+
+        // Returns the allocator of the states.
+        // Requires the option Allocator<Alloc>.
+        constexpr allocator_storage_t get_allocator() const
+            requires s_hasAllocator
+        {
+            return m_alloc;
+        }
+
+        template <typename State>
+        constexpr State& getState()
+        {
+            static_assert(valid_state_v<State>, "invalid state type");
+            return m_states.template get<State>();
+        }
+
+        template <typename State>
+        constexpr const State& getState() const
+        {
+            static_assert(valid_state_v<State>, "invalid state type");
+            return m_states.template get<State>();
         }
 
         // In sequence, this function does:
         //   - change state to NewState
         //   - calls NewState::enter  (if it exists)
         template <typename NewState>
-        void enterState()
+        constexpr void enterState()
         {
             static_assert(valid_state_v<NewState>, "invalid state type");
 
-            // change state
-            m_currentState = getStateIndex<NewState>();
+            details::bracket(
+                [&] {
+                    if constexpr (traces_enter_v<NewState>)
+                        return m_tracer.template onEnter<NewState>(*fsm(), currentStateId());
+                },
+                [&] {
+                    // change state (with UnionStorage, destroys the old state and constructs the new one)
+                    if constexpr (s_hasAllocator)
+                        m_states.template emplace<NewState>(m_alloc);
+                    else
+                        m_states.template emplace<NewState>();
+                    setStateId(static_cast<state_id_t>(getStateIndex<NewState>()));
 
-            // if there is a method NewState::enter(FSM*), then invoke it
-            constexpr bool hasEnter = requires (NewState && s) { s.enter(fsm()); };
-            if constexpr (hasEnter)
-                std::get<NewState>(m_states).enter(fsm());
+                    // cancel the timeout of the old state, and arm the timeout of the new one
+                    if constexpr (s_hasTimeouts) {
+                        if (m_timeouts.m_wheel) {
+                            if constexpr (details::has_timeout_v<NewState>)
+                                m_timeouts.m_wheel->arm(m_timeouts.m_timer, uint64_t(NewState::timeout), unsigned(getStateIndex<NewState>()));
+                            else
+                                m_timeouts.m_wheel->cancel(m_timeouts.m_timer);
+                        }
+                    }
+
+                    // if there is a method NewState::enter(FSM*), then invoke it
+                    constexpr bool hasEnter = requires (NewState && s) { s.enter(fsm()); };
+                    if constexpr (hasEnter)
+                        m_states.template get<NewState>().enter(fsm());
+                },
+                [&](const auto&...token) {
+                    if constexpr (requires { m_tracer.template onEntered<NewState>(*fsm(), token...); })
+                        m_tracer.template onEntered<NewState>(*fsm(), token...);
+                });
+        }
+
+        // Transition from the current state From to the state To. In sequence, this function does:
+        //   - calls From::exit  (if it exists)
+        //   - calls action()  (if specified)
+        //   - change state to To and calls To::enter (if it exists), as enterState<To>
+        // Everything is resolved at compile time: the current state must be From.
+        template <typename From, typename To, typename Action = details::no_action>
+        constexpr void transitionTo(Action&& action = {})
+        {
+            static_assert(valid_state_v<From>, "invalid state type");
+            constexpr bool hasExit = requires (From && s) { s.exit(fsm()); };
+            if constexpr (hasExit)
+                m_states.template get<From>().exit(fsm());
+            action();
+            enterState<To>();
+        }
+
+        // As transitionTo<From, To>, with From deduced from the pointer to the current state,
+        // e.g., from a non static handler, transitionTo<NewState>(this)
+        template <typename To, typename From, typename Action = details::no_action>
+        constexpr void transitionTo(const From*, Action&& action = {})
+        {
+            transitionTo<From, To>(std::forward<Action>(action));
         }
 
         template <typename Event>
-        void process(const Event& ev)
+        constexpr void process(const Event& ev)
+        {
+            deliver(ev);
+        }
+
+        // Returns the index of Event in the list of the option EventTypes<Events...>
+        template <typename Event>
+        static consteval unsigned eventIndex()
+            requires s_hasEventTypes
+        {
+            static_assert(raw_dispatch<event_types_option_t>::template contains_v<Event>, "the event type is not in the list of the EventTypes option");
+            return unsigned(raw_dispatch<event_types_option_t>::template index_v<Event>);
+        }
+
+        // Processes the event pointed by ev, of the type with index eventIndex in the list of the option EventTypes<Events...>,
+        // with a single indexed call through a dense [event][state] table.
+        // eventIndex must be valid. Returns true if the current state handles the event, or if the event is queued
+        // because a handler is suspended, and false if it is dropped because the queue is full.
+        bool processRaw(size_t eventIndex, const void* ev)
+            requires s_hasEventTypes
+        {
+            using raw_t = raw_dispatch<event_types_option_t>;
+            if constexpr (s_hasAsyncHandlers)
+                if (suspended())
+                    return raw_t::s_deliver[eventIndex](*this, ev);
+            const raw_handler_t f = raw_t::s_table[eventIndex * s_nStates + stateId()];
+            return f && f(*this, ev);
+        }
+
+        // Processes in sequence all events in the span.
+        // Events can be all of the same type, or of type std::variant<Events...>.
+        // If the events are all of the same type, the loop terminates as soon as
+        // the current state does not handle the event, since the remaining events
+        // cannot cause any further transition, unless the tracer must be notified of
+        // the unhandled events, or events are queued while a handler is suspended.
+        template <typename Event, size_t Extent>
+        constexpr void processBatch(std::span<Event, Extent> evs)
         {
-            // to debug this, just put a breakpoint in the function _process
-            if constexpr (s_nStates <= 4) {
-                _TINIEST_FSM_DISPATCH(4, _TINIEST_FSM_DISPATCH_IMPL)
+            using event_t = std::remove_cv_t<Event>;
+            if constexpr (details::is_variant_v<event_t>) {
+                for (const event_t& ev : evs)
+                    std::visit([this](const auto& e) { deliver(e); }, ev);
             }
-            else if constexpr (s_nStates <= 16) {
-                _TINIEST_FSM_DISPATCH(16, _TINIEST_FSM_DISPATCH_IMPL)
+            else if constexpr (s_hasAsyncHandlers || (false || ... || traces_unhandled_v<States, event_t>)) {
+                for (const event_t& ev : evs)
+                    deliver(ev);
             }
-            else if constexpr (s_nStates <= 64) {
-                _TINIEST_FSM_DISPATCH(64, _TINIEST_FSM_DISPATCH_IMPL)
+            else {
+                for (const event_t& ev : evs)
+                    if (!deliver(ev))
+                        break;
+            }
+        }
+
+        // Adds the event to the queue, to be processed by drain.
+        // Returns false, and drops the event, if the queue is full.
+        // Requires the option EventQueue<Capacity, Events...>, with Event in Events.
+        template <typename Event>
+        constexpr bool post(const Event& ev)
+            requires s_hasEventQueue
+        {
+            static_assert(event_queue_option_t::template accepts_v<Event>, "the event type is not in the list of the EventQueue option");
+            if (!queueEvent(ev))
+                return false;
+            if constexpr (requires { m_tracer.onPost(*fsm(), ev); })
+                m_tracer.onPost(*fsm(), ev);
+            return true;
+        }
+
+        // Processes all events in the queue, including those posted while draining.
+        // If invoked while already draining (i.e. from a handler), returns immediately.
+        // Stops if a handler suspends: the remaining events are processed when it completes.
+        // Requires the option EventQueue<Capacity, Events...>.
+        constexpr void drain()
+            requires s_hasEventQueue
+        {
+            if (m_queue.m_draining)
+                return;
+            if constexpr (requires { m_tracer.onDrain(*fsm()); })
+                m_tracer.onDrain(*fsm());
+            m_queue.m_draining = true;
+            while (m_queue.size() > 0 && !suspended()) {
+                const auto ev = m_queue.pop();
+                std::visit([this]<typename Event>(const Event& e) {
+                    if constexpr (!std::is_same_v<Event, std::monostate>)
+                        dispatch(e);
+                }, ev);
+            }
+            m_queue.m_draining = false;
+            if constexpr (requires { m_tracer.onDrained(*fsm()); })
+                m_tracer.onDrained(*fsm());
+        }
+
+        // Returns the number of events in the queue.
+        // Requires the option EventQueue<Capacity, Events...>.
+        constexpr size_t pendingEvents() const
+            requires s_hasEventQueue
+        {
+            return m_queue.size();
+        }
+
+        // Returns the number of events dropped because the queue was full, by post or while a handler was suspended.
+        // Requires the option EventQueue<Capacity, Events...>.
+        constexpr size_t droppedEvents() const
+            requires s_hasEventQueue
+        {
+            return m_queue.m_dropped;
+        }
+
+        // Attaches the state machine to the timer wheel, as the timer with the given id, which must not be used by other
+        // state machines attached to the same wheel, and arms the timeout of the current state.
+        // The state machine must not be destroyed, or moved, while attached.
+        template <typename Wheel>
+        void attachTimer(Wheel& wheel, uint32_t timer)
+            requires s_hasTimeouts
+        {
+            detachTimer();
+            m_timeouts.m_wheel = &wheel;
+            m_timeouts.m_timer = timer;
+            if (const uint64_t timeout = s_timeouts[stateId()]; timeout != s_noTimeout)
+                wheel.arm(timer, timeout, currentStateId());
+        }
+
+        // Cancels the timeout of the current state, and detaches the state machine from its timer wheel
+        void detachTimer()
+            requires s_hasTimeouts
+        {
+            if (m_timeouts.m_wheel)
+                m_timeouts.m_wheel->cancel(m_timeouts.m_timer);
+            m_timeouts.m_wheel = nullptr;
+        }
+
+        // Returns true if a coroutine handler is suspended, i.e. events are being queued.
+        constexpr bool suspended() const
+        {
+            if constexpr (s_hasAsyncHandlers)
+                return bool(m_async.m_inFlight);
+            else
+                return false;
+        }
+    };
+
+    // the strategy used by FSM::process to dispatch Event, e.g.
+    //     static_assert(dispatch_strategy_v<Door, OpenEvent> == DispatchStrategy::Single);
+    template <typename FSM, typename Event>
+    inline constexpr DispatchStrategy dispatch_strategy_v = FSM::template dispatchStrategy<Event>();
+
+    // *****************************
+    // Orthogonal regions
+    //
+
+    // The states of a state machine, partitioned in orthogonal regions, each a std::tuple of states.
+    // The state machine is at the same time in one state of each region.
+    template <typename...RegionStates>
+    struct Regions {};
+
+    // A state machine with orthogonal regions. The current state of all regions is packed in a single id,
+    // in mixed radix, where the digit of region i is the index of the current state in its region.
+    // Each event is dispatched to the current state of every region, in the order in which regions are listed.
+    // If the number of combinations of states is at most 256, there is a single switch on the packed id,
+    // whose cases invoke directly the handlers of all regions; otherwise there is a switch per region.
+    // Events are dispatched to the states which were current when process was invoked, even if a handler
+    // changes the state of another region.
+    template <typename DerivedClass, typename...RegionStates, typename...Options>
+        requires
+            ( (sizeof...(RegionStates) > 0)
+            && details::distinct_tuple_v<decltype(std::tuple_cat(std::declval<RegionStates>()...))>    // states must be distinct, also across regions
+            && (true && ... && (std::tuple_size_v<RegionStates> > 0))
+            )
+    class StateMachine<DerivedClass, Regions<RegionStates...>, Options...>
+    {
+        static_assert(sizeof...(Options) == 0, "options are not supported by state machines with orthogonal regions");
+
+        // *****************************
+        // constants
+        //
+
+        static constexpr size_t s_nRegions = sizeof...(RegionStates);
+
+        static constexpr std::array<size_t, s_nRegions> s_regionSizes = { std::tuple_size_v<RegionStates>... };
+
+        static_assert((true && ... && (std::tuple_size_v<RegionStates> <= 256)), "regions can have at most 256 states");
+
+        // true if the number of combinations of states fits in 32 bits, as currentStateId returns the packed id as unsigned
+        static constexpr bool s_idFits = [] {
+            uint64_t n = 1;
+            for (const size_t size : s_regionSizes) {
+                if (n > (uint64_t(1) << 32) / size)
+                    return false;
+                n *= size;
             }
-            else if constexpr (s_nStates <= 256) {
-                _TINIEST_FSM_DISPATCH(256, _TINIEST_FSM_DISPATCH_IMPL)
+            return true;
+        }();
+
+        static_assert(s_idFits, "the number of combinations of the states of all regions must be at most 2^32");
+
+        // the weight of the digit of each region in the packed id
+        static constexpr std::array<size_t, s_nRegions> s_strides = [] {
+            std::array<size_t, s_nRegions> strides{};
+            size_t stride = 1;
+            for (size_t r = 0; r < s_nRegions; ++r) {
+                strides[r] = stride;
+                stride *= s_regionSizes[r];
+            }
+            return strides;
+        }();
+
+        // number of combinations of states
+        static constexpr size_t s_nStates = (size_t(1) * ... * std::tuple_size_v<RegionStates>);
+
+        // *****************************
+        // typedefs
+        //
+
+        using FSM = DerivedClass;
+        using this_t = StateMachine<DerivedClass, Regions<RegionStates...>, Options...>;
+
+        template <size_t Region>
+        using region_t = std::tuple_element_t<Region, std::tuple<RegionStates...>>;
+
+        template <size_t Region, size_t StateIndex>
+        using state_t = details::tuple_at_t<StateIndex, region_t<Region>>;
+
+    public:
+
+        // the smallest unsigned type which can represent all packed ids
+        using state_id_t = details::uint_for_t<s_nStates>;
+
+    private:
+
+        // *****************************
+        // data members
+        //
+
+        state_id_t m_currentState{};
+        [[no_unique_address]] std::tuple<RegionStates...> m_states;
+
+        // *****************************
+        // auxiliary functions
+        //
+
+        // the index of the region of State, or s_nRegions if State is not a valid state
+        template <typename State>
+        static constexpr size_t region_of_v = [] {
+            constexpr std::array<bool, s_nRegions> isIn = { (details::index_in_tuple_v<State, RegionStates> < std::tuple_size_v<RegionStates>)... };
+            return size_t(std::ranges::find(isIn, true) - isIn.begin());
+        }();
+
+        template <typename State>
+        static constexpr bool valid_state_v = region_of_v<State> < s_nRegions;
+
+        template <typename State>
+        static constexpr size_t index_in_region_v = details::index_in_tuple_v<State, region_t<region_of_v<State>>>;
+
+        template <typename State, typename Event>
+        static constexpr bool has_handler_v = details::has_handler_v<FSM, State, Event>;
+
+        // true if any state of the region handles Event
+        template <size_t Region, typename Event>
+        static constexpr bool region_handles_v = []<typename...Ss>(std::tuple<Ss...>*) {
+            return (false || ... || has_handler_v<Ss, Event>);
+        }((region_t<Region>*)nullptr);
+
+        constexpr FSM* fsm() { return (FSM*)this; }
+
+        constexpr state_id_t stateId() const
+        {
+            return m_currentState;
+        }
+
+        static constexpr size_t digit(size_t id, size_t region)
+        {
+            return (id / s_strides[region]) % s_regionSizes[region];
+        }
+
+        template <size_t Region, size_t StateIndex, typename Event>
+        constexpr bool processFromState(const Event& ev)
+        {
+            using State = state_t<Region, StateIndex>;
+            if constexpr (has_handler_v<State, Event>) {
+                std::get<StateIndex>(std::get<Region>(m_states)).handle(fsm(), ev);
+                return true;
+            }
+            else
+                return false;
+        }
+
+        // processes the event in all regions, given the packed id of the current states
+        template <size_t Id, typename Event>
+        constexpr bool processFromIndex(const Event& ev)
+        {
+            return [&]<size_t...Rs>(std::index_sequence<Rs...>) {
+                bool handled = false;
+                ((handled |= processFromState<Rs, digit(Id, Rs)>(ev)), ...);
+                return handled;
+            }(std::make_index_sequence<s_nRegions>{});
+        }
+
+        // dispatches an event to the current state of a single region
+        template <size_t Region>
+        struct region_dispatcher
+        {
+            static constexpr size_t s_nStates = s_regionSizes[Region];
+
+            this_t& m_fsm;
+            size_t m_index;
+
+            constexpr size_t stateId() const { return m_index; }
+
+            template <size_t StateIndex, typename Event>
+            constexpr bool processFromIndex(const Event& ev)
+            {
+                return m_fsm.template processFromState<Region, StateIndex>(ev);
+            }
+
+            template <typename Event>
+            constexpr bool dispatch(const Event& ev)
+            {
+                _TINIEST_FSM_SWITCH
+            }
+        };
+
+        // returns true if the current state of any region has a handler for Event
+        template <typename Event>
+        constexpr bool dispatch(const Event& ev)
+        {
+            if constexpr (s_nStates <= 256) {
+                _TINIEST_FSM_SWITCH
             }
             else {
-                using process_fun_t = void (StateMachine::*)(const Event&);
-                static constexpr process_fun_t f[s_nStates] = { (has_handler_v<States,Event> ? &this_t::processFromState<States, Event> : nullptr)... };
-                if (f[m_currentState])
-                    std::invoke(f[m_currentState], this, ev);
+                const size_t id = stateId();
+                return [&]<size_t...Rs>(std::index_sequence<Rs...>) {
+                    bool handled = false;
+                    ((handled |= region_handles_v<Rs, Event> && region_dispatcher<Rs>{ *this, digit(id, Rs) }.dispatch(ev)), ...);
+                    return handled;
+                }(std::make_index_sequence<s_nRegions>{});
             }
         }
+
+    public:
+
+        // Returns the packed id of the current states of all regions
+        constexpr unsigned currentStateId() const
+        {
+            return stateId();
+        }
+
+        // Returns the index of the current state of the region Region
+        template <size_t Region>
+        constexpr unsigned currentStateId() const
+        {
+            static_assert(Region < s_nRegions, "invalid region");
+            return unsigned(digit(stateId(), Region));
+        }
+
+        // Returns the index of State in its region, i.e. the value returned by currentStateId<Region>
+        // when the current state of the region is State
+        template <typename State>
+        static consteval unsigned stateIndex()
+        {
+            static_assert(valid_state_v<State>, "invalid state type");
+            return unsigned(index_in_region_v<State>);
+        }
+
+        // Returns true if State is the current state of its region
+        template <typename State>
+        constexpr bool inState() const
+        {
+            static_assert(valid_state_v<State>, "invalid state type");
+            return digit(stateId(), region_of_v<State>) == index_in_region_v<State>;
+        }
+
+        template <typename State>
+        constexpr State& getState()
+        {
+            static_assert(valid_state_v<State>, "invalid state type");
+            return std::get<State>(std::get<region_of_v<State>>(m_states));
+        }
+
+        template <typename State>
+        constexpr const State& getState() const
+        {
+            static_assert(valid_state_v<State>, "invalid state type");
+            return std::get<State>(std::get<region_of_v<State>>(m_states));
+        }
+
+        // In sequence, this function does:
+        //   - change the current state of the region of NewState to NewState
+        //   - calls NewState::enter  (if it exists)
+        template <typename NewState>
+        constexpr void enterState()
+        {
+            static_assert(valid_state_v<NewState>, "invalid state type");
+            constexpr size_t region = region_of_v<NewState>;
+            const size_t id = stateId();
+            m_currentState = static_cast<state_id_t>(id + (index_in_region_v<NewState> - digit(id, region)) * s_strides[region]);
+            constexpr bool hasEnter = requires (NewState && s) { s.enter(fsm()); };
+            if constexpr (hasEnter)
+                std::get<NewState>(std::get<region>(m_states)).enter(fsm());
+        }
+
+        template <typename Event>
+        constexpr void process(const Event& ev)
+        {
+            dispatch(ev);
+        }
+    };
+
+    namespace details {
+
+        struct fsm_access
+        {
+            template <typename FSM>
+            struct states { using type = typename FSM::states_t; };
+
+            template <typename FSM>
+            using states_t = typename states<FSM>::type;
+
+            template <typename FSM>
+            static constexpr size_t nStates = FSM::s_nStates;
+
+            template <typename FSM, typename State, typename Event>
+            static constexpr bool hasHandler = FSM::template is_handled_v<State, Event>;
+
+            template <typename FSM>
+            struct transition_table { using type = typename FSM::transition_table_t; };
+
+            template <typename FSM>
+            using transition_table_t = typename transition_table<FSM>::type;
+
+            template <typename FSM, typename State>
+            static constexpr bool entersAny = FSM::template enters_any_v<State>;
+
+            template <typename FSM>
+            static constexpr auto reachable = FSM::s_reachable;
+
+            template <typename State, typename FSM, typename Event>
+            static bool processFromState(FSM& fsm, const Event& ev)
+            {
+                return fsm.template processFromState<State>(ev);
+            }
+
+            template <typename T>
+            static constexpr bool hasAsyncHandlers = requires { requires T::s_hasAsyncHandlers; };
+
+            // true if FSM has the option EventQueue<Capacity, Events...>, with Event in Events
+            template <typename FSM, typename Event>
+            static constexpr bool queueAccepts = [] {
+                if constexpr (FSM::s_hasEventQueue)
+                    return FSM::event_queue_option_t::template accepts_v<Event>;
+                else
+                    return false;
+            }();
+
+            template <typename FSM>
+            static auto& asyncSlot(FSM& fsm) { return fsm.m_async; }
+
+            template <typename FSM>
+            static void onAsyncHandler(void* fsm, std::coroutine_handle<> h) { static_cast<FSM*>(fsm)->onAsyncHandler(h); }
+        };
+
+    } // namespace details
+
+    // The return type of handlers which are coroutines, in state machines with the option AsyncHandlers, e.g.
+    //     static Task handle(auto* fsm, QuoteEvent ev) { auto price = co_await fetch(ev.symbol); ... }
+    // The coroutine starts immediately, and its frame is owned by the state machine, so a Task is just a tag.
+    // The state machine must be one of the parameters, as a pointer. The event should be taken by value,
+    // as the event passed to process is gone when the coroutine resumes.
+    // The state machine must not be moved or destroyed while a handler is suspended.
+    class Task
+    {
+    public:
+
+        class promise_type
+        {
+            // the frame is preceded by a header with a pointer to the flag of the arena, or nullptr if allocated on the heap
+            static constexpr size_t s_header = alignof(std::max_align_t);
+
+            void* m_fsm;
+            void (*m_notify)(void*, std::coroutine_handle<>);
+
+            template <typename Arg>
+            static constexpr bool is_fsm_v = std::is_pointer_v<Arg> && details::fsm_access::hasAsyncHandlers<std::remove_cv_t<std::remove_pointer_t<Arg>>>;
+
+            // the state machine, among the parameters of the coroutine
+            template <typename...Args>
+            static auto& fsmOf(Args&...args)
+            {
+                constexpr std::array<bool, sizeof...(Args)> isFsm = { is_fsm_v<Args>... };
+                constexpr size_t i = size_t(std::ranges::find(isFsm, true) - isFsm.begin());
+                static_assert(i < sizeof...(Args), "a coroutine returning Task must take a pointer to a state machine with the option AsyncHandlers");
+                return *std::get<i>(std::tie(args...));
+            }
+
+            struct final_awaiter
+            {
+                bool await_ready() noexcept { return false; }
+
+                void await_suspend(std::coroutine_handle<promise_type> h) noexcept
+                {
+                    void* fsm = h.promise().m_fsm;
+                    auto notify = h.promise().m_notify;
+                    h.destroy();  // before processing the queued events, so that the arena is free
+                    notify(fsm, nullptr);
+                }
+
+                void await_resume() noexcept {}
+            };
+
+        public:
+
+            template <typename...Args>
+            static void* operator new(size_t n, Args&...args)
+            {
+                auto& slot = details::fsm_access::asyncSlot(fsmOf(args...));
+                std::byte* p;
+                bool* owner = nullptr;
+                if (!slot.m_frameInUse && n + s_header <= slot.m_frame.size()) {
+                    slot.m_frameInUse = true;
+                    p = slot.m_frame.data();
+                    owner = &slot.m_frameInUse;
+                }
+                else
+                    p = static_cast<std::byte*>(::operator new(n + s_header));
+                ::new (static_cast<void*>(p)) bool*(owner);
+                return p + s_header;
+            }
+
+            static void operator delete(void* frame, size_t)
+            {
+                std::byte* p = static_cast<std::byte*>(frame) - s_header;
+                bool* owner = *std::launder(reinterpret_cast<bool**>(p));
+                if (owner)
+                    *owner = false;
+                else
+                    ::operator delete(p);
+            }
+
+            template <typename...Args>
+            promise_type(Args&...args)
+            {
+                auto& fsm = fsmOf(args...);
+                m_fsm = &fsm;
+                m_notify = &details::fsm_access::onAsyncHandler<std::remove_reference_t<decltype(fsm)>>;
+            }
+
+            Task get_return_object()
+            {
+                m_notify(m_fsm, std::coroutine_handle<promise_type>::from_promise(*this));
+                return Task{};
+            }
+
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            final_awaiter final_suspend() noexcept { return {}; }
+            void return_void() {}
+
+            // there is nobody to rethrow to, as the handler may have been resumed by an event loop
+            void unhandled_exception() { std::terminate(); }
+        };
     };
 
 } // namespace tiniest_fsm
@@ -219,11 +2278,21 @@ namespace tiniest_fsm {
 #undef _TINIEST_FSM_DISPATCH_4
 #undef _TINIEST_FSM_DISPATCH_16
 #undef _TINIEST_FSM_DISPATCH_64
+#undef _TINIEST_FSM_DISPATCH_128
 #undef _TINIEST_FSM_DISPATCH_256
 #undef _TINIEST_FSM_DISPATCH
 #undef _TINIEST_FSM_DISPATCH_IMPL
+#undef _TINIEST_FSM_SWITCH
 #undef _TINIEST_FSM_CASE
 #undef _TINIEST_FSM_UNREACHABLE
+#undef _TINIEST_FSM_HOT
+#undef _TINIEST_FSM_HAS_COMPUTED_GOTO
+#undef _TINIEST_FSM_GOTO_ROW
+#undef _TINIEST_FSM_GOTO_16
+#undef _TINIEST_FSM_GOTO_256
+#undef _TINIEST_FSM_GOTO_ADDRESS
+#undef _TINIEST_FSM_GOTO_LABEL
+#undef _TINIEST_FSM_GOTO
 
 
 /*
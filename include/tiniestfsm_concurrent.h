@@ -0,0 +1,245 @@
+#pragma once
+
+#include <tiniestfsm.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace tiniest_fsm {
+
+    namespace details {
+
+        // size of a cache line, used to keep apart data written by different threads
+        constexpr size_t s_cacheLine = 64;
+
+        inline void cpu_relax()
+        {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+            _mm_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+
+    } // namespace details
+
+    // *****************************
+    // Wait strategies
+    //
+    // A thread waiting for a condition reads a counter, checks the condition and, if false, invokes wait
+    // with the value read. The thread which makes the condition true increments the counter and invokes notify,
+    // but only if s_needsNotify is true.
+    //
+
+    // Busy waits: lowest latency, burns a core
+    struct SpinWait
+    {
+        static constexpr bool s_needsNotify = false;
+        static void wait(const std::atomic<uint32_t>&, uint32_t) { details::cpu_relax(); }
+        static void notify(std::atomic<uint32_t>&) {}
+    };
+
+    // Yields the processor to other threads while waiting
+    struct YieldWait
+    {
+        static constexpr bool s_needsNotify = false;
+        static void wait(const std::atomic<uint32_t>&, uint32_t) { std::this_thread::yield(); }
+        static void notify(std::atomic<uint32_t>&) {}
+    };
+
+    // Sleeps in the kernel (a futex on Linux) until notified: no cpu used while idle,
+    // but each notification costs an atomic increment and, if a thread is sleeping, a system call
+    struct FutexWait
+    {
+        static constexpr bool s_needsNotify = true;
+        static void wait(const std::atomic<uint32_t>& counter, uint32_t old) { counter.wait(old, std::memory_order_acquire); }
+        static void notify(std::atomic<uint32_t>& counter) { counter.notify_all(); }
+    };
+
+    namespace details {
+
+        // waits, according to the wait strategy Wait, until cond() is true
+        // counter must be signalled after any change which may make cond() true
+        template <typename Wait, typename Cond>
+        void wait_until(const std::atomic<uint32_t>& counter, Cond&& cond)
+        {
+            for (;;) {
+                const uint32_t old = counter.load(std::memory_order_acquire);
+                if (cond())
+                    return;
+                Wait::wait(counter, old);
+            }
+        }
+
+        template <typename Wait>
+        void signal(std::atomic<uint32_t>& counter)
+        {
+            if constexpr (Wait::s_needsNotify) {
+                counter.fetch_add(1, std::memory_order_release);
+                Wait::notify(counter);
+            }
+        }
+
+    } // namespace details
+
+    // Option of ConcurrentStateMachine and FsmExecutor: the number of events which can be queued, must be a power of 2 (default 1024)
+    template <size_t N>
+    struct QueueCapacity : details::option<QueueCapacity<0>>
+    {
+        static constexpr size_t value = N;
+    };
+
+    // Option of ConcurrentStateMachine and FsmExecutor: how producers and consumer wait, one of SpinWait, YieldWait (default) or FutexWait
+    template <typename Policy>
+    struct WaitStrategy : details::option<WaitStrategy<void>>
+    {
+        using type = Policy;
+    };
+
+    template <typename...Ts>
+    class ConcurrentStateMachine;
+
+    // A state machine of type FSM which can receive events of types Events... from multiple producer threads.
+    // Events are pushed into a bounded lock-free multi producer single consumer queue, and processed,
+    // in order, by a single consumer thread, which is the only one accessing the state machine.
+    // When the queue is full, post waits (back-pressure), while tryPost fails.
+    template <typename FSM, typename...Events, typename...Options>
+    class ConcurrentStateMachine<FSM, std::tuple<Events...>, Options...>
+    {
+        static_assert(sizeof...(Events) > 0, "at least one event type is required");
+        static_assert(details::are_distinct_v<Events...>, "event types must be distinct");
+
+        static constexpr size_t s_capacity = details::find_option_t<QueueCapacity<0>, QueueCapacity<1024>, Options...>::value;
+        static_assert(s_capacity > 0 && (s_capacity & (s_capacity - 1)) == 0, "the capacity of the queue must be a power of 2");
+
+        using wait_t = typename details::find_option_t<WaitStrategy<void>, WaitStrategy<YieldWait>, Options...>::type;
+
+        // a slot of the queue. In lap k, slot i is free for the producers when m_seq == i + k * capacity,
+        // and holds an event for the consumer when m_seq == i + k * capacity + 1
+        struct Cell
+        {
+            std::atomic<size_t> m_seq;
+            std::variant<std::monostate, Events...> m_event;
+        };
+
+        alignas(details::s_cacheLine) std::atomic<size_t> m_head{ 0 };           // next slot to be written, shared by producers
+        alignas(details::s_cacheLine) std::atomic<uint32_t> m_pushed{ 0 };       // incremented when an event is pushed
+        alignas(details::s_cacheLine) size_t m_tail = 0;                         // next slot to be read, owned by the consumer
+        std::atomic<uint32_t> m_popped{ 0 };                                     // incremented when the consumer frees slots
+        std::atomic<bool> m_stop{ false };
+        alignas(details::s_cacheLine) std::unique_ptr<Cell[]> m_cells;
+        FSM m_fsm;
+
+        bool hasEvent() const
+        {
+            return m_cells[m_tail & (s_capacity - 1)].m_seq.load(std::memory_order_acquire) == m_tail + 1;
+        }
+
+        bool isFull() const
+        {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            return intptr_t(m_cells[head & (s_capacity - 1)].m_seq.load(std::memory_order_acquire)) - intptr_t(head) < 0;
+        }
+
+    public:
+
+        template <typename...Args>
+        explicit ConcurrentStateMachine(Args&&...args)
+            : m_cells(new Cell[s_capacity])
+            , m_fsm(std::forward<Args>(args)...)
+        {
+            for (size_t i = 0; i < s_capacity; ++i)
+                m_cells[i].m_seq.store(i, std::memory_order_relaxed);
+        }
+
+        ConcurrentStateMachine(const ConcurrentStateMachine&) = delete;
+        ConcurrentStateMachine& operator=(const ConcurrentStateMachine&) = delete;
+
+        static constexpr size_t capacity() { return s_capacity; }
+
+        // The state machine. Must be accessed only by the consumer thread, or while no consumer is running.
+        FSM& machine() { return m_fsm; }
+        const FSM& machine() const { return m_fsm; }
+
+        // Producers: queues the event. Returns false if the queue is full. Wait free if the queue is not contended.
+        template <typename Event>
+        bool tryPost(const Event& ev)
+        {
+            static_assert(details::elem_in_list_v<Event, Events...>, "the event type is not in the list of events");
+            size_t pos = m_head.load(std::memory_order_relaxed);
+            Cell* cell;
+            for (;;) {
+                cell = &m_cells[pos & (s_capacity - 1)];
+                const intptr_t diff = intptr_t(cell->m_seq.load(std::memory_order_acquire)) - intptr_t(pos);
+                if (diff == 0) {
+                    if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                    return false;  // the slot still holds the event of the previous lap
+                else
+                    pos = m_head.load(std::memory_order_relaxed);
+            }
+            cell->m_event.template emplace<Event>(ev);
+            cell->m_seq.store(pos + 1, std::memory_order_release);
+            details::signal<wait_t>(m_pushed);
+            return true;
+        }
+
+        // Producers: queues the event, waiting while the queue is full
+        template <typename Event>
+        void post(const Event& ev)
+        {
+            while (!tryPost(ev))
+                details::wait_until<wait_t>(m_popped, [this] { return !isFull(); });
+        }
+
+        // Consumer: processes up to maxBatch queued events, without waiting, and returns the number processed
+        size_t poll(size_t maxBatch = s_capacity)
+        {
+            size_t n = 0;
+            for (; n < maxBatch && hasEvent(); ++n, ++m_tail) {
+                Cell& cell = m_cells[m_tail & (s_capacity - 1)];
+                std::visit([this]<typename Event>(const Event& e) {
+                    if constexpr (!std::is_same_v<Event, std::monostate>)
+                        m_fsm.process(e);
+                }, cell.m_event);
+                cell.m_event.template emplace<std::monostate>();
+                cell.m_seq.store(m_tail + s_capacity, std::memory_order_release);
+            }
+            if (n > 0)
+                details::signal<wait_t>(m_popped);
+            return n;
+        }
+
+        // Consumer: waits until there are queued events, then processes up to maxBatch of them.
+        // Returns the number of events processed, which is 0 only once stop was requested and the queue is empty.
+        size_t consume(size_t maxBatch = s_capacity)
+        {
+            details::wait_until<wait_t>(m_pushed, [this] { return hasEvent() || m_stop.load(std::memory_order_acquire); });
+            return poll(maxBatch);
+        }
+
+        // Consumer: processes events until stop is requested and the queue is empty
+        void run(size_t maxBatch = s_capacity)
+        {
+            while (consume(maxBatch) > 0) {}
+        }
+
+        // Any thread: asks the consumer to return from run once all queued events are processed
+        void requestStop()
+        {
+            m_stop.store(true, std::memory_order_release);
+            m_pushed.fetch_add(1, std::memory_order_release);
+            wait_t::notify(m_pushed);
+        }
+    };
+
+} // namespace tiniest_fsm
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <tiniestfsm.h>
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <tmmintrin.h>
+#define _TINIEST_FSM_DFA_SSSE3
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define _TINIEST_FSM_DFA_NEON
+#endif
+
+namespace tiniest_fsm {
+
+    // *****************************
+    // Character classes, for the transitions of ByteDfa
+    //
+
+    // the bytes in [Lo, Hi]
+    template <unsigned char Lo, unsigned char Hi>
+    struct CharRange
+    {
+        static constexpr bool contains(unsigned char c) { return c >= Lo && c <= Hi; }
+    };
+
+    // the bytes Cs...
+    template <unsigned char...Cs>
+    struct CharSet
+    {
+        static constexpr bool contains(unsigned char c) { return (false || ... || (c == Cs)); }
+    };
+
+    // any byte
+    struct AnyChar
+    {
+        static constexpr bool contains(unsigned char) { return true; }
+    };
+
+    // the bytes not in CharClass
+    template <typename CharClass>
+    struct NotChar
+    {
+        static constexpr bool contains(unsigned char c) { return !CharClass::contains(c); }
+    };
+
+    // a transition to the state To, on any byte in CharClass
+    template <typename CharClass, typename To>
+    struct On
+    {
+        using char_class_t = CharClass;
+        using to_t = To;
+    };
+
+    namespace details {
+
+        // the transitions of State, i.e. State::on, or an empty list if State does not declare any
+        template <typename State>
+        struct dfa_transitions { using type = std::tuple<>; };
+
+        template <typename State> requires requires { typename State::on; }
+        struct dfa_transitions<State> { using type = typename State::on; };
+
+    } // namespace details
+
+    template <typename...Ts>
+    class ByteDfa;
+
+    // A deterministic finite automaton on bytes, for tokenizers and validators.
+    // Each state declares its transitions as a list of On<CharClass, To>:
+    //     struct InNumber { using on = std::tuple<On<CharRange<'0', '9'>, InNumber>, On<AnyChar, Done>>; };
+    // On each byte, the first transition of the current state whose class contains the byte is taken.
+    // If there is none, the state does not change.
+    // At compile time, bytes with the same transitions in all states are merged in classes, and the transitions
+    // are compiled in a dense [state][class] table. With up to 16 states, if SSSE3 or NEON are available, the
+    // transitions of each byte are instead a shuffle of the vector of all states, applied with one instruction
+    // per byte to several chunks of the input in parallel.
+    template <typename...States>
+        requires
+            ( details::are_distinct_v<States...>
+            && (sizeof...(States) > 0)
+            && (sizeof...(States) <= 65536)
+            )
+    class ByteDfa<std::tuple<States...>>
+    {
+        // *****************************
+        // constants
+        //
+
+        static constexpr size_t s_nStates = sizeof...(States);
+
+    public:
+
+        // the smallest unsigned type which can represent all state ids
+        using state_id_t = details::uint_for_t<s_nStates>;
+
+    private:
+
+        template <typename State>
+        static constexpr bool valid_state_v = details::elem_in_list_v<State, States...>;
+
+        template <typename State>
+        static constexpr size_t index_v = details::index_in_tuple_v<State, std::tuple<States...>>;
+
+        // the state after State on byte c
+        template <typename State>
+        static constexpr size_t next(unsigned char c)
+        {
+            return []<typename...Ts>(std::tuple<Ts...>*, [[maybe_unused]] unsigned char c) {
+                static_assert((true && ... && valid_state_v<typename Ts::to_t>), "the target of a transition is not a valid state");
+                size_t to = index_v<State>;
+                (void)((Ts::char_class_t::contains(c) && (to = index_v<typename Ts::to_t>, true)) || ...);
+                return to;
+            }((typename details::dfa_transitions<State>::type*)nullptr, c);
+        }
+
+        // bytes are merged in classes, which have the same transitions in all states
+        struct byte_classes
+        {
+            std::array<uint8_t, 256> classOf{};
+            std::array<uint8_t, 256> representative{};  // a byte for each class
+            size_t n = 0;
+        };
+
+        static constexpr byte_classes s_classes = [] {
+            byte_classes res;
+            const auto same = [](unsigned char a, unsigned char b) { return (true && ... && (next<States>(a) == next<States>(b))); };
+            for (unsigned c = 0; c < 256; ++c) {
+                size_t k = 0;
+                while (k < res.n && !same((unsigned char)c, res.representative[k]))
+                    ++k;
+                if (k == res.n)
+                    res.representative[res.n++] = uint8_t(c);
+                res.classOf[c] = uint8_t(k);
+            }
+            return res;
+        }();
+
+        static constexpr size_t s_nClasses = s_classes.n;
+
+        // the entries of the dense table are offsets of rows, i.e. state id * s_nClasses,
+        // so that the loop does not need a multiplication
+        using offset_t = details::uint_for_t<s_nStates * s_nClasses>;
+
+        static constexpr std::array<offset_t, s_nStates * s_nClasses> s_table = [] {
+            std::array<offset_t, s_nStates * s_nClasses> table{};
+            for (size_t k = 0; k < s_nClasses; ++k) {
+                const std::array<size_t, s_nStates> to = { next<States>(s_classes.representative[k])... };
+                for (size_t s = 0; s < s_nStates; ++s)
+                    table[s * s_nClasses + k] = offset_t(to[s] * s_nClasses);
+            }
+            return table;
+        }();
+
+        static constexpr size_t s_maxShuffleStates = 16;
+
+        // for each byte, the vector of the next state of each state (padded with identity)
+        alignas(16) static constexpr std::array<std::array<uint8_t, 16>, 256> s_shuffles = [] {
+            std::array<std::array<uint8_t, 16>, 256> shuffles{};
+            if constexpr (s_nStates <= s_maxShuffleStates)
+                for (unsigned c = 0; c < 256; ++c) {
+                    const std::array<size_t, s_nStates> to = { next<States>((unsigned char)c)... };
+                    for (size_t s = 0; s < 16; ++s)
+                        shuffles[c][s] = uint8_t(s < s_nStates ? to[s] : s);
+                }
+            return shuffles;
+        }();
+
+        // *****************************
+        // data members
+        //
+
+        state_id_t m_currentState = 0;
+
+        static constexpr state_id_t scanTable(state_id_t state, const char* begin, const char* end)
+        {
+            size_t offset = size_t(state) * s_nClasses;
+            for (; begin != end; ++begin)
+                offset = s_table[offset + s_classes.classOf[(unsigned char)*begin]];
+            return state_id_t(offset / s_nClasses);
+        }
+
+#if defined(_TINIEST_FSM_DFA_SSSE3) || defined(_TINIEST_FSM_DFA_NEON)
+
+        static constexpr size_t s_nChunks = 4;
+
+        // each chunk is scanned from all states at once. Then the final state of each chunk is the initial
+        // state of the next one.
+        static state_id_t scanShuffle(state_id_t state, const char* input, size_t n)
+        {
+            const auto* p = reinterpret_cast<const unsigned char*>(input);
+            const size_t chunk = n / s_nChunks;
+            alignas(16) std::array<std::array<uint8_t, 16>, s_nChunks> finals;
+#if defined(_TINIEST_FSM_DFA_SSSE3)
+            const auto load = [](unsigned char c) { return _mm_load_si128(reinterpret_cast<const __m128i*>(s_shuffles[c].data())); };
+            const __m128i identity = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+            __m128i v[s_nChunks];
+            for (size_t k = 0; k < s_nChunks; ++k)
+                v[k] = identity;
+            for (size_t i = 0; i < chunk; ++i)
+                for (size_t k = 0; k < s_nChunks; ++k)
+                    v[k] = _mm_shuffle_epi8(load(p[k * chunk + i]), v[k]);
+            for (size_t k = 0; k < s_nChunks; ++k)
+                _mm_store_si128(reinterpret_cast<__m128i*>(finals[k].data()), v[k]);
+#else
+            const auto load = [](unsigned char c) { return vld1q_u8(s_shuffles[c].data()); };
+            static constexpr uint8_t s_identity[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+            uint8x16_t v[s_nChunks];
+            for (size_t k = 0; k < s_nChunks; ++k)
+                v[k] = vld1q_u8(s_identity);
+            for (size_t i = 0; i < chunk; ++i)
+                for (size_t k = 0; k < s_nChunks; ++k)
+                    v[k] = vqtbl1q_u8(load(p[k * chunk + i]), v[k]);
+            for (size_t k = 0; k < s_nChunks; ++k)
+                vst1q_u8(finals[k].data(), v[k]);
+#endif
+            for (size_t k = 0; k < s_nChunks; ++k)
+                state = finals[k][state];
+            return scanTable(state, input + s_nChunks * chunk, input + n);
+        }
+
+#endif
+
+    public:
+
+        // Returns the id of State, i.e. the value returned by currentStateId when the current state is State
+        template <typename State>
+        static consteval unsigned stateIndex()
+        {
+            static_assert(valid_state_v<State>, "invalid state type");
+            return unsigned(index_v<State>);
+        }
+
+        // number of classes of bytes, i.e. the number of columns of the transition table
+        static constexpr size_t byteClasses()
+        {
+            return s_nClasses;
+        }
+
+        constexpr unsigned currentStateId() const
+        {
+            return m_currentState;
+        }
+
+        template <typename State>
+        constexpr void enterState()
+        {
+            m_currentState = state_id_t(stateIndex<State>());
+        }
+
+        // processes all bytes in the input and returns the id of the new current state
+        constexpr unsigned scan(std::string_view input)
+        {
+#if defined(_TINIEST_FSM_DFA_SSSE3) || defined(_TINIEST_FSM_DFA_NEON)
+            if constexpr (s_nStates <= s_maxShuffleStates) {
+                if (!std::is_constant_evaluated() && input.size() >= 64) {
+                    m_currentState = scanShuffle(m_currentState, input.data(), input.size());
+                    return m_currentState;
+                }
+            }
+#endif
+            m_currentState = scanTable(m_currentState, input.data(), input.data() + input.size());
+            return m_currentState;
+        }
+
+        // Processes independent inputs, each from the state in initial, and stores the final states into final.
+        // Inputs are processed four at a time, interleaved, to overlap the latency of the table lookups.
+        static void scan(std::span<const std::string_view> inputs, std::span<const state_id_t> initial, std::span<state_id_t> final)
+        {
+            constexpr size_t nStreams = 4;
+            size_t i = 0;
+            for (; i + nStreams <= inputs.size(); i += nStreams) {
+                std::array<size_t, nStreams> offsets;
+                std::array<const char*, nStreams> p;
+                size_t common = inputs[i].size();
+                for (size_t k = 0; k < nStreams; ++k) {
+                    offsets[k] = size_t(initial[i + k]) * s_nClasses;
+                    p[k] = inputs[i + k].data();
+                    common = std::min(common, inputs[i + k].size());
+                }
+                for (size_t j = 0; j < common; ++j)
+                    for (size_t k = 0; k < nStreams; ++k)
+                        offsets[k] = s_table[offsets[k] + s_classes.classOf[(unsigned char)p[k][j]]];
+                for (size_t k = 0; k < nStreams; ++k)
+                    final[i + k] = scanTable(state_id_t(offsets[k] / s_nClasses), p[k] + common, p[k] + inputs[i + k].size());
+            }
+            for (; i < inputs.size(); ++i)
+                final[i] = scanTable(initial[i], inputs[i].data(), inputs[i].data() + inputs[i].size());
+        }
+    };
+
+} // namespace tiniest_fsm
+
+#undef _TINIEST_FSM_DFA_SSSE3
+#undef _TINIEST_FSM_DFA_NEON
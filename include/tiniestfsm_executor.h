@@ -0,0 +1,343 @@
+#pragma once
+
+#include <tiniestfsm_concurrent.h>
+#include <tiniestfsm_pool.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace tiniest_fsm {
+
+    namespace details {
+
+        // a bounded single producer single consumer queue of Capacity elements of type T
+        // producer and consumer cache the position of each other, to touch the shared cache lines only when needed
+        template <typename T, size_t Capacity>
+        class spsc_queue
+        {
+            static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "the capacity of the queue must be a power of 2");
+
+            alignas(s_cacheLine) std::atomic<size_t> m_head{ 0 };  // written by the producer
+            size_t m_cachedTail = 0;
+            alignas(s_cacheLine) std::atomic<size_t> m_tail{ 0 };  // written by the consumer
+            size_t m_cachedHead = 0;
+            alignas(s_cacheLine) std::atomic<uint32_t> m_popped{ 0 };
+            std::array<T, Capacity> m_items;
+
+        public:
+
+            // the counter signalled by the consumer when it frees slots
+            std::atomic<uint32_t>& popped() { return m_popped; }
+
+            bool empty() const
+            {
+                return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_relaxed);
+            }
+
+            bool full()
+            {
+                const size_t head = m_head.load(std::memory_order_relaxed);
+                return head - m_tail.load(std::memory_order_acquire) == Capacity;
+            }
+
+            // producer
+            template <typename...Args>
+            bool tryPush(Args&&...args)
+            {
+                const size_t head = m_head.load(std::memory_order_relaxed);
+                if (head - m_cachedTail == Capacity) {
+                    m_cachedTail = m_tail.load(std::memory_order_acquire);
+                    if (head - m_cachedTail == Capacity)
+                        return false;
+                }
+                m_items[head & (Capacity - 1)] = T{ std::forward<Args>(args)... };
+                m_head.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+            // consumer: invokes f(T&) on up to n elements, in order, and returns how many were consumed
+            template <typename F>
+            size_t consume(size_t n, F&& f)
+            {
+                const size_t tail = m_tail.load(std::memory_order_relaxed);
+                if (m_cachedHead - tail < n)
+                    m_cachedHead = m_head.load(std::memory_order_acquire);
+                const size_t k = std::min(n, m_cachedHead - tail);
+                for (size_t i = 0; i < k; ++i)
+                    f(m_items[(tail + i) & (Capacity - 1)]);
+                if (k > 0)
+                    m_tail.store(tail + k, std::memory_order_release);
+                return k;
+            }
+        };
+
+    } // namespace details
+
+    template <typename...Ts>
+    class FsmExecutor;
+
+    // Runs many instances of the state machine FSM, receiving events of types Events..., on a set of worker threads.
+    // Each instance is identified by a 64 bit key and belongs to shard key % nShards.
+    // Each shard is a StateMachinePool processed by at most one worker at a time, so handlers need no locks.
+    // Each producer has its own single producer single consumer inbox per shard, so the events sent by a
+    // producer to an instance are processed in the order they were sent.
+    // Shard s is normally processed by worker s % nWorkers: a worker with no work steals whole shards with
+    // pending events from the other workers. With FutexWait, when events are posted to a shard whose worker
+    // is busy, an idle worker is woken to steal it.
+    // The options are QueueCapacity<N> (the capacity of each inbox) and WaitStrategy<Policy>.
+    template <typename FSM, typename...Events, typename...Options>
+    class FsmExecutor<FSM, std::tuple<Events...>, Options...>
+    {
+        static_assert(sizeof...(Events) > 0, "at least one event type is required");
+        static_assert(details::are_distinct_v<Events...>, "event types must be distinct");
+
+        static constexpr size_t s_capacity = details::find_option_t<QueueCapacity<0>, QueueCapacity<1024>, Options...>::value;
+
+        using wait_t = typename details::find_option_t<WaitStrategy<void>, WaitStrategy<YieldWait>, Options...>::type;
+
+        struct Message
+        {
+            uint32_t m_instance;  // index of the instance in the pool of the shard
+            std::variant<std::monostate, Events...> m_event;
+        };
+
+        using inbox_t = details::spsc_queue<Message, s_capacity>;
+
+        struct alignas(details::s_cacheLine) Shard
+        {
+            std::atomic<bool> m_busy{ false };
+            StateMachinePool<FSM> m_pool;
+            std::unordered_map<uint64_t, uint32_t> m_index;  // key -> instance, immutable once started
+        };
+
+        struct alignas(details::s_cacheLine) Worker
+        {
+            std::atomic<uint32_t> m_signal{ 0 };  // signalled when events are posted to one of its shards
+            std::atomic<bool> m_idle{ false };    // true while waiting for a signal (only with FutexWait)
+        };
+
+        const size_t m_nShards;
+        const size_t m_nProducers;
+        std::vector<Shard> m_shards;
+        std::vector<Worker> m_workers;
+        std::unique_ptr<inbox_t[]> m_inboxes;  // [shard][producer]
+        std::vector<std::thread> m_threads;
+        std::atomic<bool> m_stop{ false };
+        alignas(details::s_cacheLine) std::atomic<uint32_t> m_nIdle{ 0 };  // number of workers for which m_idle is true
+
+        inbox_t& inbox(size_t shard, size_t producer) { return m_inboxes[shard * m_nProducers + producer]; }
+
+        size_t shardOf(uint64_t key) const { return size_t(key % m_nShards); }
+        size_t homeOf(size_t shard) const { return shard % m_workers.size(); }
+
+        bool hasPending(size_t shard)
+        {
+            for (size_t p = 0; p < m_nProducers; ++p)
+                if (!inbox(shard, p).empty())
+                    return true;
+            return false;
+        }
+
+        bool anyPending()
+        {
+            for (size_t s = 0; s < m_nShards; ++s)
+                if (hasPending(s))
+                    return true;
+            return false;
+        }
+
+        // Wakes one idle worker, which steals the shards of worker home with pending events, when home is busy:
+        // either a producer posted to a shard of home which is not idle (unlessHomeIdle), or home has pending events
+        // in another shard while processing one. Workers which spin or yield find the shards by themselves.
+        // Each idle worker is woken at most once, by the thread which resets its flag m_idle.
+        void wakeThief(size_t home, bool unlessHomeIdle)
+        {
+            // read-modify-write, ordered with the increment in sleep: either the producer sees the worker idle,
+            // or the worker sees the event
+            if (m_nIdle.fetch_add(0, std::memory_order_acq_rel) == 0)
+                return;
+            if (unlessHomeIdle && m_workers[home].m_idle.load(std::memory_order_relaxed))
+                return;
+            for (size_t k = 1; k < m_workers.size(); ++k) {
+                Worker& thief = m_workers[(home + k) % m_workers.size()];
+                bool idle = true;
+                if (thief.m_idle.load(std::memory_order_relaxed) && thief.m_idle.compare_exchange_strong(idle, false)) {
+                    details::signal<wait_t>(thief.m_signal);
+                    return;
+                }
+            }
+        }
+
+        // waits for a signal, after announcing that the worker is idle, so that producers can wake it to steal work
+        void sleep(Worker& worker, uint32_t old)
+        {
+            worker.m_idle.store(true, std::memory_order_relaxed);
+            m_nIdle.fetch_add(1, std::memory_order_acq_rel);
+            if (!anyPending())
+                wait_t::wait(worker.m_signal, old);
+            worker.m_idle.store(false, std::memory_order_relaxed);
+            m_nIdle.fetch_sub(1, std::memory_order_release);
+        }
+
+        // processes a batch of events from each inbox of the shard, unless another worker is processing it
+        size_t runShard(size_t s)
+        {
+            Shard& shard = m_shards[s];
+            if (shard.m_busy.load(std::memory_order_relaxed) || shard.m_busy.exchange(true, std::memory_order_acquire))
+                return 0;
+            size_t n = 0;
+            for (size_t p = 0; p < m_nProducers; ++p) {
+                inbox_t& in = inbox(s, p);
+                const size_t k = in.consume(s_capacity, [&](Message& msg) {
+                    std::visit([&]<typename Event>(const Event& ev) {
+                        if constexpr (!std::is_same_v<Event, std::monostate>)
+                            shard.m_pool.process(msg.m_instance, ev);
+                    }, msg.m_event);
+                });
+                if (k > 0)
+                    details::signal<wait_t>(in.popped());
+                n += k;
+            }
+            shard.m_busy.store(false, std::memory_order_release);
+            return n;
+        }
+
+        void work(size_t w)
+        {
+            const size_t nWorkers = m_workers.size();
+            std::atomic<uint32_t>& signal = m_workers[w].m_signal;
+            for (;;) {
+                const uint32_t old = signal.load(std::memory_order_acquire);
+                size_t n = 0;
+                for (size_t s = w; s < m_nShards; s += nWorkers) {
+                    if constexpr (wait_t::s_needsNotify)
+                        if (n > 0 && hasPending(s))
+                            wakeThief(w, false);
+                    n += runShard(s);
+                }
+                if (n > 0)
+                    continue;
+                // steal, starting from the shards of the next worker
+                for (size_t k = 1; k < m_nShards; ++k) {
+                    const size_t s = (w + k) % m_nShards;
+                    if (homeOf(s) != w && hasPending(s))
+                        n += runShard(s);
+                }
+                if (n > 0)
+                    continue;
+                if (m_stop.load(std::memory_order_acquire)) {
+                    bool idle = true;
+                    for (size_t s = 0; s < m_nShards && idle; ++s)
+                        idle = !hasPending(s);
+                    if (idle)
+                        return;
+                }
+                else if constexpr (wait_t::s_needsNotify)
+                    sleep(m_workers[w], old);
+                else
+                    wait_t::wait(signal, old);
+            }
+        }
+
+    public:
+
+        // A producer thread. Each producer must be used by one thread at a time.
+        class Producer
+        {
+            friend class FsmExecutor;
+
+            FsmExecutor* m_exec;
+            size_t m_id;
+
+            Producer(FsmExecutor* exec, size_t id) : m_exec(exec), m_id(id) {}
+
+        public:
+
+            // Queues the event for the instance with the given key, which must exist.
+            // Returns false if the inbox is full.
+            template <typename Event>
+            bool tryPost(uint64_t key, const Event& ev)
+            {
+                static_assert(details::elem_in_list_v<Event, Events...>, "the event type is not in the list of events");
+                const size_t s = m_exec->shardOf(key);
+                const uint32_t instance = m_exec->m_shards[s].m_index.at(key);
+                if (!m_exec->inbox(s, m_id).tryPush(instance, std::variant<std::monostate, Events...>(std::in_place_type<Event>, ev)))
+                    return false;
+                const size_t home = m_exec->homeOf(s);
+                details::signal<wait_t>(m_exec->m_workers[home].m_signal);
+                if constexpr (wait_t::s_needsNotify)
+                    m_exec->wakeThief(home, true);
+                return true;
+            }
+
+            // Queues the event for the instance with the given key, waiting while the inbox is full
+            template <typename Event>
+            void post(uint64_t key, const Event& ev)
+            {
+                while (!tryPost(key, ev)) {
+                    inbox_t& in = m_exec->inbox(m_exec->shardOf(key), m_id);
+                    details::wait_until<wait_t>(in.popped(), [&] { return !in.full(); });
+                }
+            }
+        };
+
+        FsmExecutor(size_t nWorkers, size_t nShards, size_t nProducers)
+            : m_nShards(nShards)
+            , m_nProducers(nProducers)
+            , m_shards(nShards)
+            , m_workers(nWorkers)
+            , m_inboxes(new inbox_t[nShards * nProducers])
+        {
+        }
+
+        FsmExecutor(const FsmExecutor&) = delete;
+        FsmExecutor& operator=(const FsmExecutor&) = delete;
+
+        ~FsmExecutor()
+        {
+            stop();
+        }
+
+        // Creates an instance with the given key, passing args to the constructor of FSM, in state InitialState.
+        // Must be called before start.
+        template <typename InitialState, typename...Args>
+        void emplace(uint64_t key, Args&&...args)
+        {
+            Shard& shard = m_shards[shardOf(key)];
+            const auto [it, inserted] = shard.m_index.emplace(key, uint32_t(shard.m_pool.size()));
+            if (inserted)
+                shard.m_pool.template emplace<InitialState>(std::forward<Args>(args)...);
+        }
+
+        // The instance with the given key. Must not be used while the executor is running.
+        const FSM& operator[](uint64_t key) const
+        {
+            const Shard& shard = m_shards[shardOf(key)];
+            return shard.m_pool[shard.m_index.at(key)];
+        }
+
+        Producer producer(size_t id) { return Producer(this, id); }
+
+        // starts the worker threads
+        void start()
+        {
+            m_stop.store(false, std::memory_order_relaxed);
+            for (size_t w = 0; w < m_workers.size(); ++w)
+                m_threads.emplace_back([this, w] { work(w); });
+        }
+
+        // waits until all queued events are processed, then stops the worker threads
+        void stop()
+        {
+            m_stop.store(true, std::memory_order_release);
+            for (Worker& w : m_workers) {
+                w.m_signal.fetch_add(1, std::memory_order_release);
+                wait_t::notify(w.m_signal);
+            }
+            for (std::thread& t : m_threads)
+                t.join();
+            m_threads.clear();
+        }
+    };
+
+} // namespace tiniest_fsm
@@ -0,0 +1,392 @@
+#pragma once
+
+#include <tiniestfsm.h>
+
+#include <vector>
+#include <cassert>
+#include <utility>
+#include <bit>
+
+#if defined(__AVX2__) || defined(__AVX512BW__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace tiniest_fsm {
+
+    namespace details {
+
+        // the list of indices of the states in std::tuple<States...> which have a handler for Event
+        template <typename FSM, typename Event, typename StatesTuple, typename Is>
+        struct handling_states;
+
+        template <typename FSM, typename Event, typename...States, size_t...Is>
+        struct handling_states<FSM, Event, std::tuple<States...>, std::index_sequence<Is...>>
+        {
+            static constexpr size_t size = (0u + ... + fsm_access::hasHandler<FSM, States, Event>);
+
+            // indices[k] is the index of the k-th state with a handler for Event
+            static constexpr std::array<size_t, size> indices = [] {
+                std::array<size_t, size> res{};
+                size_t k = 0;
+                ((fsm_access::hasHandler<FSM, States, Event> ? (void)(res[k++] = Is) : (void)0), ...);
+                return res;
+            }();
+
+            // bucket[i] is the position in indices of the state i, or size if state i has no handler for Event
+            static constexpr std::array<size_t, sizeof...(States)> bucket = [] {
+                std::array<size_t, sizeof...(States)> res{};
+                res.fill(size);
+                for (size_t k = 0; k < size; ++k)
+                    res[indices[k]] = k;
+                return res;
+            }();
+        };
+
+        template <typename FSM, typename Event>
+        using handling_states_t = handling_states<FSM, Event, fsm_access::states_t<FSM>,
+            std::make_index_sequence<fsm_access::nStates<FSM>>>;
+
+        // invokes f(i) for each i in [0, n) such that ids[i] == value, in increasing order of i
+        // The comparison is done in blocks with SIMD instructions, when available for the type Id.
+        // f(i) may modify ids[i].
+        template <typename Id, typename F>
+        inline void for_each_equal(const Id* ids, size_t n, Id value, F&& f)
+        {
+            size_t i = 0;
+
+            // calls f for each element in the block starting at i, flagged in mask
+            // Each element is represented by Stride consecutive bits of the mask.
+            auto forEachBit = [&]<unsigned Stride>(auto mask) {
+                for (; mask; mask &= mask - 1)
+                    f(i + std::countr_zero(mask) / Stride);
+            };
+
+#if defined(__AVX512BW__)
+            if constexpr (sizeof(Id) == 1) {
+                const __m512i v = _mm512_set1_epi8(static_cast<char>(value));
+                for (; i + 64 <= n; i += 64)
+                    forEachBit.template operator()<1>(uint64_t(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(ids + i), v)));
+            }
+            else if constexpr (sizeof(Id) == 2) {
+                const __m512i v = _mm512_set1_epi16(static_cast<short>(value));
+                for (; i + 32 <= n; i += 32)
+                    forEachBit.template operator()<1>(uint32_t(_mm512_cmpeq_epi16_mask(_mm512_loadu_si512(ids + i), v)));
+            }
+#elif defined(__AVX2__)
+            if constexpr (sizeof(Id) == 1) {
+                const __m256i v = _mm256_set1_epi8(static_cast<char>(value));
+                for (; i + 32 <= n; i += 32) {
+                    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids + i));
+                    forEachBit.template operator()<1>(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, v))));
+                }
+            }
+            else if constexpr (sizeof(Id) == 2) {
+                const __m256i v = _mm256_set1_epi16(static_cast<short>(value));
+                for (; i + 16 <= n; i += 16) {
+                    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids + i));
+                    forEachBit.template operator()<2>(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi16(x, v))) & 0x55555555u);
+                }
+            }
+#elif defined(__SSE2__) || defined(_M_X64)
+            if constexpr (sizeof(Id) == 1) {
+                const __m128i v = _mm_set1_epi8(static_cast<char>(value));
+                for (; i + 16 <= n; i += 16) {
+                    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ids + i));
+                    forEachBit.template operator()<1>(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(x, v))));
+                }
+            }
+            else if constexpr (sizeof(Id) == 2) {
+                const __m128i v = _mm_set1_epi16(static_cast<short>(value));
+                for (; i + 8 <= n; i += 8) {
+                    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ids + i));
+                    forEachBit.template operator()<2>(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi16(x, v))) & 0x5555u);
+                }
+            }
+#elif defined(__ARM_NEON)
+            // NEON has no movemask: narrow each comparison result to 4 (uint8) or 8 (uint16) bits
+            if constexpr (sizeof(Id) == 1) {
+                const uint8x16_t v = vdupq_n_u8(value);
+                for (; i + 16 <= n; i += 16) {
+                    const uint8x16_t eq = vceqq_u8(vld1q_u8(ids + i), v);
+                    const uint64_t m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+                    forEachBit.template operator()<4>(m & 0x8888888888888888ull);
+                }
+            }
+            else if constexpr (sizeof(Id) == 2) {
+                const uint16x8_t v = vdupq_n_u16(value);
+                for (; i + 8 <= n; i += 8) {
+                    const uint16x8_t eq = vceqq_u16(vld1q_u16(ids + i), v);
+                    const uint64_t m = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(eq)), 0);
+                    forEachBit.template operator()<8>(m & 0x8080808080808080ull);
+                }
+            }
+#endif
+            for (; i < n; ++i)
+                if (ids[i] == value)
+                    f(i);
+        }
+
+    } // namespace details
+
+    // Policy of StateMachinePool: the instances and their state ids are stored in std::vector (default)
+    struct VectorPoolStorage
+    {
+        template <typename FSM, typename StateId>
+        class type
+        {
+            std::vector<StateId> m_ids;
+            std::vector<FSM> m_machines;
+
+        public:
+            size_t size() const { return m_machines.size(); }
+
+            void reserve(size_t n)
+            {
+                m_ids.reserve(n);
+                m_machines.reserve(n);
+            }
+
+            StateId* ids() { return m_ids.data(); }
+            const StateId* ids() const { return m_ids.data(); }
+
+            FSM* machines() { return m_machines.data(); }
+            const FSM* machines() const { return m_machines.data(); }
+
+            // appends a new instance constructed with args, and its state id
+            template <typename...Args>
+            void emplace_back(Args&&...args)
+            {
+                m_machines.emplace_back(std::forward<Args>(args)...);
+                m_ids.emplace_back();
+            }
+        };
+    };
+
+    // A pool of identical state machines of type FSM.
+    // The current state ids of all instances are stored in a packed array, separately from the
+    // instances themselves, so that broadcasting an event touches only the instances whose
+    // current state has a handler for the event.
+    // Instances must be modified only via the pool, as otherwise the packed array of state
+    // ids goes out of sync.
+    // Storage is the policy which stores instances and ids, e.g. VectorPoolStorage, MappedPoolStorage
+    // (see tiniestfsm_snapshot.h) or SharedPoolStorage (see tiniestfsm_shared.h). The arguments of the constructor of
+    // the pool are passed to the storage. If the storage defines beginWrite(i) and endWrite(i), all modifications of
+    // instance i are enclosed between the two calls. If it defines storeId(i, id), the state ids are stored with it.
+    template <typename FSM, typename Storage = VectorPoolStorage>
+    class StateMachinePool
+    {
+        // *****************************
+        // constants
+        //
+
+        static constexpr size_t s_nStates = details::fsm_access::nStates<FSM>;
+
+        // above this number of states handling an event, broadcast groups the instances
+        // with a counting sort rather than with one SIMD pass per state
+        static constexpr size_t s_maxCompressBuckets = 8;
+
+        // *****************************
+        // typedefs
+        //
+
+        using states_t = details::fsm_access::states_t<FSM>;
+        using index_t = uint32_t;
+
+    public:
+        using state_id_t = typename FSM::state_id_t;
+
+    private:
+
+        // *****************************
+        // data members
+        //
+
+        typename Storage::template type<FSM, state_id_t> m_storage;
+        std::vector<index_t> m_scratch;   // instances grouped by state in broadcast
+
+        // *****************************
+        // auxiliary functions
+        //
+
+        state_id_t* ids() { return m_storage.ids(); }
+        FSM* instances() { return m_storage.machines(); }
+
+        // stores the state id with the storage hook storeId(i, id), if the storage defines one
+        // (e.g. the atomic store of SharedPoolStorage, as other processes read the ids concurrently)
+        void sync(size_t instance)
+        {
+            const auto id = static_cast<state_id_t>(instances()[instance].currentStateId());
+            if constexpr (requires { m_storage.storeId(instance, id); })
+                m_storage.storeId(instance, id);
+            else
+                ids()[instance] = id;
+        }
+
+        // invokes f(FSM&) on the instance and syncs its state id, within the write section of the instance,
+        // if the storage defines one (e.g. the seqlock of SharedPoolStorage)
+        template <typename F>
+        void write(size_t instance, F&& f)
+        {
+            constexpr bool hasWriteSection = requires { m_storage.beginWrite(instance); m_storage.endWrite(instance); };
+            if constexpr (hasWriteSection)
+                m_storage.beginWrite(instance);
+            f(instances()[instance]);
+            sync(instance);
+            if constexpr (hasWriteSection)
+                m_storage.endWrite(instance);
+        }
+
+        template <size_t StateIndex, typename Event>
+        void processRun(const index_t* begin, const index_t* end, const Event& ev)
+        {
+            using State = details::tuple_at_t<StateIndex, states_t>;
+            for (; begin != end; ++begin)
+                write(*begin, [&](FSM& fsm) { details::fsm_access::processFromState<State>(fsm, ev); });
+        }
+
+    public:
+
+        template <typename...Args>
+        explicit StateMachinePool(Args&&...args)
+            : m_storage(std::forward<Args>(args)...)
+        {
+        }
+
+        size_t size() const
+        {
+            return m_storage.size();
+        }
+
+        void reserve(size_t n)
+        {
+            m_storage.reserve(n);
+        }
+
+        // the packed array of the current state ids of all instances
+        std::span<const state_id_t> stateIds() const
+        {
+            return { m_storage.ids(), size() };
+        }
+
+        // all instances
+        std::span<const FSM> machines() const
+        {
+            return { m_storage.machines(), size() };
+        }
+
+        // the storage of the instances, e.g. to flush a MappedPoolStorage
+        auto& storage()
+        {
+            return m_storage;
+        }
+
+        // Constructs a new instance with arguments args, enters InitialState and returns
+        // the id of the newly created instance. Instance ids are assigned sequentially from 0.
+        template <typename InitialState, typename...Args>
+        size_t emplace(Args&&...args)
+        {
+            assert(size() < size_t(index_t(-1)));
+            const size_t instance = size();
+            m_storage.emplace_back(std::forward<Args>(args)...);
+            enterState<InitialState>(instance);
+            return instance;
+        }
+
+        unsigned currentStateId(size_t instance) const
+        {
+            return m_storage.ids()[instance];
+        }
+
+        const FSM& operator[](size_t instance) const
+        {
+            return m_storage.machines()[instance];
+        }
+
+        // Invokes f(FSM&) on the instance, e.g. to modify its data members
+        template <typename F>
+        void modify(size_t instance, F&& f)
+        {
+            write(instance, [&](FSM& fsm) { std::invoke(std::forward<F>(f), fsm); });
+        }
+
+        template <typename NewState>
+        void enterState(size_t instance)
+        {
+            write(instance, [](FSM& fsm) { fsm.template enterState<NewState>(); });
+        }
+
+        template <typename Event>
+        void process(size_t instance, const Event& ev)
+        {
+            write(instance, [&](FSM& fsm) { fsm.process(ev); });
+        }
+
+        // Processes the event ev in all instances.
+        // Instances are grouped by current state (scanning the packed array of ids with SIMD
+        // instructions, where available), then the handler of each state is run
+        // over the dense run of instances in that state. Each instance processes the event
+        // exactly once, from the state it was in when broadcast was called.
+        // Handlers must not modify instances other than the one they are invoked on.
+        // With the option AsyncHandlers, the event is delivered with process to each instance instead, so that
+        // the instances in which a handler is suspended queue it, whatever their current state.
+        template <typename Event>
+        void broadcast(const Event& ev)
+        {
+            using handling = details::handling_states_t<FSM, Event>;
+            constexpr size_t nBuckets = handling::size;
+
+            if constexpr (details::fsm_access::hasAsyncHandlers<FSM>) {
+                for (size_t i = 0, n = size(); i < n; ++i)
+                    write(i, [&](FSM& fsm) { fsm.process(ev); });
+            }
+            else if constexpr (nBuckets == 0) {
+                // no state has a handler for Event
+            }
+            else if constexpr (nBuckets == 1) {
+                // processing an instance changes only the state of that instance, so a single pass is enough
+                constexpr auto stateIndex = static_cast<state_id_t>(handling::indices[0]);
+                using State = details::tuple_at_t<stateIndex, states_t>;
+                details::for_each_equal(ids(), size(), stateIndex, [&](size_t i) {
+                    write(i, [&](FSM& fsm) { details::fsm_access::processFromState<State>(fsm, ev); });
+                });
+            }
+            else if constexpr (nBuckets <= s_maxCompressBuckets) {
+                // one SIMD pass per handling state, compressing the matching instances into a run
+                std::array<index_t, nBuckets + 1> offsets{};
+                m_scratch.resize(size());
+                index_t* runs = m_scratch.data();
+                [&]<size_t...Bs>(std::index_sequence<Bs...>) {
+                    ((offsets[Bs + 1] = offsets[Bs],
+                      details::for_each_equal(ids(), size(), static_cast<state_id_t>(handling::indices[Bs]),
+                        [&](size_t i) { runs[offsets[Bs + 1]++] = static_cast<index_t>(i); })), ...);
+                    (processRun<handling::indices[Bs]>(runs + offsets[Bs], runs + offsets[Bs + 1], ev), ...);
+                }(std::make_index_sequence<nBuckets>{});
+            }
+            else {
+                // counting sort of the instances by current state, in two passes
+                std::array<index_t, nBuckets + 2> offsets{};
+                for (const state_id_t id : stateIds())
+                    if (const size_t b = handling::bucket[id]; b != nBuckets)
+                        ++offsets[b + 2];
+                for (size_t b = 2; b < nBuckets + 2; ++b)
+                    offsets[b] += offsets[b - 1];
+                m_scratch.resize(offsets[nBuckets + 1]);
+                for (size_t i = 0, n = size(); i < n; ++i) {
+                    const size_t b = handling::bucket[ids()[i]];
+                    if (b != nBuckets)
+                        m_scratch[offsets[b + 1]++] = static_cast<index_t>(i);
+                }
+                // now bucket b is the range [offsets[b], offsets[b+1])
+                const index_t* runs = m_scratch.data();
+                [&]<size_t...Bs>(std::index_sequence<Bs...>) {
+                    (processRun<handling::indices[Bs]>(runs + offsets[Bs], runs + offsets[Bs + 1], ev), ...);
+                }(std::make_index_sequence<nBuckets>{});
+            }
+        }
+    };
+
+} // namespace tiniest_fsm
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <tiniestfsm.h>
+
+namespace tiniest_fsm {
+
+    // a transition of the TransitionTable
+    struct TransitionInfo
+    {
+        unsigned from;      // state ids
+        unsigned to;
+        unsigned event;     // index of the event in the list of events of Reflection, or eventCount if not in the list
+        bool guarded;
+        bool hasAction;
+    };
+
+    // a state which can be entered by the handlers, enter or exit of another state, as declared in its targets
+    struct TargetInfo
+    {
+        unsigned from;
+        unsigned to;
+    };
+
+    namespace details {
+
+        template <typename FSM, typename States, typename Events>
+        struct reflection;
+
+        template <typename FSM, typename...States, typename...Events>
+        struct reflection<FSM, std::tuple<States...>, std::tuple<Events...>>
+        {
+            static constexpr size_t s_nStates = sizeof...(States);
+            static constexpr size_t s_nEvents = sizeof...(Events);
+
+            template <typename State>
+            static constexpr unsigned state_v = unsigned(index_in_tuple_v<State, std::tuple<States...>>);
+
+            template <typename Event>
+            static constexpr unsigned event_v = unsigned(index_in_tuple_v<Event, std::tuple<Events...>>);
+
+            template <typename...Ts>
+            static constexpr std::array<TransitionInfo, sizeof...(Ts)> transitions(type_list<Ts...>)
+            {
+                return { TransitionInfo{ state_v<typename Ts::from_t>, state_v<typename Ts::to_t>, event_v<typename Ts::event_t>,
+                                         !std::is_void_v<typename Ts::guard_t>, !std::is_void_v<typename Ts::action_t> }... };
+            }
+
+            template <typename State, typename...Ts>
+            static constexpr std::array<TargetInfo, sizeof...(Ts)> targetsOf(std::tuple<Ts...>*)
+            {
+                return { TargetInfo{ state_v<State>, state_v<Ts> }... };
+            }
+
+            template <typename State>
+            static constexpr auto targetsOf()
+            {
+                using targets_t = typename declared_targets<State>::type;
+                if constexpr (std::is_void_v<targets_t>)
+                    return std::array<TargetInfo, 0>{};
+                else
+                    return targetsOf<State>((targets_t*)nullptr);
+            }
+
+            static constexpr auto targets()
+            {
+                std::array<TargetInfo, (size_t(0) + ... + targetsOf<States>().size())> res{};
+                size_t i = 0;
+                ([&] { for (const TargetInfo& t : targetsOf<States>()) res[i++] = t; }(), ...);
+                return res;
+            }
+
+            template <typename Event>
+            static constexpr std::array<bool, s_nStates> s_handles = { fsm_access::hasHandler<FSM, States, Event>... };
+
+            template <typename State>
+            static constexpr unsigned parent_v = [] {
+                if constexpr (std::is_void_v<parent_of_t<State>>)
+                    return unsigned(s_nStates);
+                else
+                    return state_v<parent_of_t<State>>;
+            }();
+        };
+
+        // appends strings to a buffer of N characters, or only counts their length if N is 0
+        template <size_t N>
+        struct string_builder
+        {
+            std::array<char, N> m_buffer{};
+            size_t m_size = 0;
+
+            constexpr string_builder& operator<<(std::string_view s)
+            {
+                for (char c : s) {
+                    if constexpr (N > 0)
+                        m_buffer[m_size] = c;
+                    ++m_size;
+                }
+                return *this;
+            }
+        };
+
+    } // namespace details
+
+    template <typename...Ts>
+    struct Reflection;
+
+    // Compile time description of the state machine FSM, as seen by events of types Events...:
+    // the names of states and events, which states handle which events, the transitions of the TransitionTable,
+    // the targets declared by the states, and which states are reachable (see ReachableFrom).
+    // All members are constexpr, including a diagram in the DOT language of Graphviz, e.g.
+    //     std::cout << Reflection<Door, std::tuple<OpenEvent, CloseEvent>>::dot;
+    template <typename FSM, typename...Events>
+    struct Reflection<FSM, std::tuple<Events...>>
+    {
+    private:
+
+        using impl = details::reflection<FSM, details::fsm_access::states_t<FSM>, std::tuple<Events...>>;
+
+    public:
+
+        static constexpr size_t stateCount = impl::s_nStates;
+        static constexpr size_t eventCount = sizeof...(Events);
+
+        // the names of the types of states and events, e.g. "Open"
+        static constexpr auto stateNames = []<typename...States>(std::tuple<States...>*) {
+            return std::array<std::string_view, stateCount>{ details::type_name<States>()... };
+        }((details::fsm_access::states_t<FSM>*)nullptr);
+
+        static constexpr std::array<std::string_view, eventCount> eventNames = { details::type_name<Events>()... };
+
+        // handles[event][state] is true if the event is handled, by a handler or a transition, when state is
+        // the current state, including by its ancestors
+        static constexpr std::array<std::array<bool, stateCount>, eventCount> handles = { impl::template s_handles<Events>... };
+
+        // the id of the parent of each state, or stateCount
+        static constexpr auto parents = []<typename...States>(std::tuple<States...>*) {
+            return std::array<unsigned, stateCount>{ impl::template parent_v<States>... };
+        }((details::fsm_access::states_t<FSM>*)nullptr);
+
+        static constexpr auto transitions = impl::transitions(typename details::fsm_access::transition_table_t<FSM>::list_t{});
+
+        static constexpr auto targets = impl::targets();
+
+        // false for dead states, which are not dispatched
+        static constexpr std::array<bool, stateCount> reachable = details::fsm_access::reachable<FSM>;
+
+        // writes the diagram to out, which must support out << std::string_view
+        // Dead states are gray, transitions declared as targets of a state are dashed.
+        template <typename Out>
+        static constexpr void writeDot(Out& out)
+        {
+            const auto node = [&](unsigned id) -> Out& { return out << "\"" << stateNames[id] << "\""; };
+            out << "digraph G {\n  rankdir=LR\n  start [shape=point];\n  start -> ";
+            node(0) << ";\n";
+            for (unsigned s = 0; s < stateCount; ++s)
+                if (!reachable[s]) {
+                    out << "  ";
+                    node(s) << " [color=gray, fontcolor=gray];\n";
+                }
+            for (const TransitionInfo& t : transitions) {
+                out << "  ";
+                node(t.from) << " -> ";
+                node(t.to) << " [label=\"" << (t.event < eventCount ? eventNames[t.event] : std::string_view("?"))
+                    << (t.guarded ? " [guard]" : "") << "\"];\n";
+            }
+            for (const TargetInfo& t : targets) {
+                out << "  ";
+                node(t.from) << " -> ";
+                node(t.to) << " [style=dashed];\n";
+            }
+            out << "}\n";
+        }
+
+    private:
+
+        static constexpr size_t s_dotSize = [] {
+            details::string_builder<0> counter;
+            writeDot(counter);
+            return counter.m_size;
+        }();
+
+        static constexpr auto s_dot = [] {
+            details::string_builder<s_dotSize> builder;
+            writeDot(builder);
+            return builder.m_buffer;
+        }();
+
+    public:
+
+        // the diagram in the DOT language
+        static constexpr std::string_view dot = { s_dot.data(), s_dot.size() };
+    };
+
+} // namespace tiniest_fsm
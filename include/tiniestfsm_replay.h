@@ -0,0 +1,299 @@
+#pragma once
+
+#include <tiniestfsm.h>
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+namespace tiniest_fsm {
+
+    // *****************************
+    // Recording and replay of events
+    //
+    // A log of events is a flat binary buffer, in the native byte order, with the layout:
+    //     EventLogHeader
+    //     for each entry: a tag, of type uint_for_t<2 * sizeof...(Events) + 1>, which is
+    //                         the index i of the event type in Events..., for an event passed to process,
+    //                         sizeof...(Events) + i, for an event passed to post,
+    //                         2 * sizeof...(Events), for a call to drain,
+    //                     followed by the bytes of the event, if any
+    //
+
+    struct EventLogHeader
+    {
+        static constexpr char s_magic[8] = { 'T', 'F', 'S', 'M', 'E', 'V', 'T', 'S' };
+        static constexpr uint32_t s_version = 2;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t eventsHash;  // details::type_hash of std::tuple<Events...>
+        uint64_t count;       // number of entries
+        uint64_t bytes;       // size of the events following the header
+    };
+
+    namespace details {
+
+        template <typename...Events>
+        struct event_log_format
+        {
+            static_assert(sizeof...(Events) > 0, "at least one event type is required");
+            static_assert(are_distinct_v<Events...>, "event types must be distinct");
+            static_assert((true && ... && std::is_trivially_copyable_v<Events>), "only trivially copyable events can be recorded");
+
+            static constexpr size_t s_nEvents = sizeof...(Events);
+            static constexpr size_t s_drainTag = 2 * s_nEvents;
+
+            using tag_t = uint_for_t<s_drainTag + 1>;
+
+            // the size of the smallest entry, a call to drain
+            static constexpr size_t s_minEntry = sizeof(tag_t);
+
+            static EventLogHeader header(uint64_t count, uint64_t bytes)
+            {
+                EventLogHeader h{};
+                std::memcpy(h.magic, EventLogHeader::s_magic, sizeof(h.magic));
+                h.version = EventLogHeader::s_version;
+                h.eventsHash = type_hash<std::tuple<Events...>>();
+                h.count = count;
+                h.bytes = bytes;
+                return h;
+            }
+        };
+
+    } // namespace details
+
+    // A tracer which records, in a compact binary log, all events passed to process, processBatch or post,
+    // and all calls to drain.
+    // Events dispatched or posted while another event is being handled (e.g. by calling process or post from a handler),
+    // and events dispatched by drain, are not recorded, as they are dispatched or posted again when the log is replayed.
+    // As this tracer implements onUnhandled, all events are dispatched with a switch (see dispatchStrategy).
+    template <typename...Events>
+    class EventRecorder
+    {
+        using format = details::event_log_format<Events...>;
+        using tag_t = typename format::tag_t;
+
+        std::vector<std::byte> m_log;
+        uint64_t m_count = 0;
+        unsigned m_depth = 0;  // number of events being handled, and of calls to drain in progress
+
+        template <typename Event>
+        void append(const Event& ev, bool posted = false)
+        {
+            static_assert(details::elem_in_list_v<Event, Events...>, "the event type is not in the list of recorded events");
+            const tag_t tag = tag_t(details::index_in_tuple_v<Event, std::tuple<Events...>> + (posted ? format::s_nEvents : 0));
+            const size_t at = m_log.size();
+            m_log.resize(at + sizeof(tag) + sizeof(Event));
+            std::memcpy(m_log.data() + at, &tag, sizeof(tag));
+            std::memcpy(m_log.data() + at + sizeof(tag), &ev, sizeof(Event));
+            ++m_count;
+        }
+
+    public:
+
+        template <typename State, typename FSM, typename Event>
+        void onEvent(const FSM&, const Event& ev)
+        {
+            if (m_depth++ == 0)
+                append(ev);
+        }
+
+        template <typename State, typename FSM, typename Event>
+        void onHandled(const FSM&, const Event&)
+        {
+            --m_depth;
+        }
+
+        template <typename State, typename FSM, typename Event>
+        void onUnhandled(const FSM&, const Event& ev)
+        {
+            if (m_depth == 0)
+                append(ev);
+        }
+
+        template <typename FSM, typename Event>
+        void onPost(const FSM&, const Event& ev)
+        {
+            if (m_depth == 0)
+                append(ev, true);
+        }
+
+        // the events dispatched by drain are not recorded, as those posted by handlers are posted again on replay
+        template <typename FSM>
+        void onDrain(const FSM&)
+        {
+            if (m_depth++ == 0) {
+                const tag_t tag = tag_t(format::s_drainTag);
+                const size_t at = m_log.size();
+                m_log.resize(at + sizeof(tag));
+                std::memcpy(m_log.data() + at, &tag, sizeof(tag));
+                ++m_count;
+            }
+        }
+
+        template <typename FSM>
+        void onDrained(const FSM&)
+        {
+            --m_depth;
+        }
+
+        // number of entries recorded (events and calls to drain)
+        uint64_t count() const { return m_count; }
+
+        // the recorded events, without header
+        std::span<const std::byte> bytes() const { return m_log; }
+
+        void clear()
+        {
+            m_log.clear();
+            m_count = 0;
+        }
+
+        // writes the log, with its header
+        void save(std::ostream& os) const
+        {
+            const EventLogHeader h = format::header(m_count, m_log.size());
+            os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            os.write(reinterpret_cast<const char*>(m_log.data()), std::streamsize(m_log.size()));
+        }
+    };
+
+    // A log of events, decoded into an array of std::variant<Events...> so that it can be replayed at full speed
+    template <typename...Events>
+    class EventLog
+    {
+        using format = details::event_log_format<Events...>;
+        using tag_t = typename format::tag_t;
+        using variant_t = std::variant<Events...>;
+
+        // an operation on the EventQueue, before the event with index m_index is processed
+        struct QueueOp
+        {
+            size_t m_index;
+            bool m_drain;    // drain is called, otherwise the event with index m_index is posted rather than processed
+        };
+
+        // the log is read in chunks of this size, so that a corrupted header cannot cause huge allocations
+        static constexpr size_t s_chunk = size_t(1) << 20;
+
+        std::vector<variant_t> m_events;
+        std::vector<QueueOp> m_queueOps;  // in the order of the log
+
+        // decodes count entries in bytes, throws std::runtime_error if the log is corrupted
+        void decode(std::span<const std::byte> bytes, uint64_t count)
+        {
+            static constexpr std::array<size_t, sizeof...(Events)> sizes = { sizeof(Events)... };
+            static constexpr std::array<void (*)(std::vector<variant_t>&, const std::byte*), sizeof...(Events)> emplace = {
+                [](std::vector<variant_t>& evs, const std::byte* p) {
+                    Events ev;
+                    std::memcpy(&ev, p, sizeof(Events));
+                    evs.emplace_back(std::in_place_type<Events>, ev);
+                }...
+            };
+            if (count > bytes.size() / format::s_minEntry)
+                throw std::runtime_error("tiniest_fsm: truncated event log");
+            m_events.reserve(m_events.size() + size_t(count));
+            size_t at = 0;
+            for (uint64_t i = 0; i < count; ++i) {
+                tag_t tag;
+                if (bytes.size() - at < sizeof(tag))
+                    throw std::runtime_error("tiniest_fsm: truncated event log");
+                std::memcpy(&tag, bytes.data() + at, sizeof(tag));
+                at += sizeof(tag);
+                if (tag == format::s_drainTag) {
+                    m_queueOps.push_back({ m_events.size(), true });
+                    continue;
+                }
+                if (tag > format::s_drainTag)
+                    throw std::runtime_error("tiniest_fsm: corrupted event log");
+                const bool posted = tag >= format::s_nEvents;
+                const size_t type = posted ? tag - format::s_nEvents : tag;
+                if (bytes.size() - at < sizes[type])
+                    throw std::runtime_error("tiniest_fsm: corrupted event log");
+                if (posted)
+                    m_queueOps.push_back({ m_events.size(), false });
+                emplace[type](m_events, bytes.data() + at);
+                at += sizes[type];
+            }
+        }
+
+        // posts the event with index i, or calls drain, as in the log
+        template <typename FSM>
+        void replayQueueOp(FSM& fsm, const QueueOp& op) const
+        {
+            if constexpr ((false || ... || details::fsm_access::queueAccepts<FSM, Events>)) {
+                if (op.m_drain)
+                    fsm.drain();
+                else
+                    std::visit([&]<typename Event>(const Event& ev) {
+                        if constexpr (details::fsm_access::queueAccepts<FSM, Event>)
+                            fsm.post(ev);
+                        else
+                            throw std::runtime_error("tiniest_fsm: the event queue of the state machine does not accept a posted event of the log");
+                    }, m_events[op.m_index]);
+            }
+            else
+                throw std::runtime_error("tiniest_fsm: the event log contains calls to post or drain, but the state machine has no event queue");
+        }
+
+    public:
+
+        EventLog() = default;
+
+        // decodes the events recorded by recorder
+        explicit EventLog(const EventRecorder<Events...>& recorder)
+        {
+            decode(recorder.bytes(), recorder.count());
+        }
+
+        // reads a log written by EventRecorder::save, throws std::runtime_error if it is not valid
+        explicit EventLog(std::istream& is)
+        {
+            EventLogHeader h;
+            if (!is.read(reinterpret_cast<char*>(&h), sizeof(h)))
+                throw std::runtime_error("tiniest_fsm: truncated event log");
+            const EventLogHeader expected = format::header(h.count, h.bytes);
+            if (std::memcmp(h.magic, expected.magic, sizeof(h.magic)) != 0 || h.version != expected.version)
+                throw std::runtime_error("tiniest_fsm: not an event log");
+            if (h.eventsHash != expected.eventsHash)
+                throw std::runtime_error("tiniest_fsm: the event log was recorded with different event types");
+            if (h.count > h.bytes / format::s_minEntry)
+                throw std::runtime_error("tiniest_fsm: corrupted event log");
+            // the buffer grows only as much as the bytes actually read
+            std::vector<std::byte> bytes;
+            while (bytes.size() < h.bytes) {
+                const size_t at = bytes.size();
+                const size_t n = size_t(std::min<uint64_t>(h.bytes - at, s_chunk));
+                bytes.resize(at + n);
+                if (!is.read(reinterpret_cast<char*>(bytes.data() + at), std::streamsize(n)))
+                    throw std::runtime_error("tiniest_fsm: truncated event log");
+            }
+            decode(bytes, h.count);
+        }
+
+        std::span<const variant_t> events() const { return m_events; }
+
+        size_t size() const { return m_events.size(); }
+
+        // processes all events of the log, in order, with FSM::processBatch, and posts events and calls drain as in the log
+        // Throws std::runtime_error if the log contains calls to post or drain which FSM does not support.
+        template <typename FSM>
+        void replay(FSM& fsm) const
+        {
+            size_t next = 0;
+            for (const QueueOp& op : m_queueOps) {
+                fsm.processBatch(events().subspan(next, op.m_index - next));
+                next = op.m_index;
+                replayQueueOp(fsm, op);
+                if (!op.m_drain)
+                    ++next;
+            }
+            fsm.processBatch(events().subspan(next));
+        }
+    };
+
+} // namespace tiniest_fsm
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <tiniestfsm_concurrent.h>
+#include <tiniestfsm_snapshot.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define _TINIEST_FSM_HAS_SHM
+#endif
+
+namespace tiniest_fsm {
+
+    // *****************************
+    // Pools of state machines in shared memory
+    //
+    // A shared memory segment with the layout:
+    //     SnapshotHeader                  (64 bytes, with the magic "TFSMSHRD")
+    //     uint32_t seq[capacity]          (the seqlock of each instance)
+    //     state_id_t ids[capacity]        (the packed array of state ids)
+    //     padding                         (up to a multiple of 64 bytes and of alignof(FSM))
+    //     FSM machines[capacity]          (the instances)
+    // of which only the first 'size' instances are in use.
+    // A single process, the writer, owns the pool and modifies the instances. Any number of processes read the
+    // current states and the instances, with no system calls and no locks: the writer increments the seqlock of an
+    // instance before and after modifying it, and readers retry if the seqlock was odd, or changed while reading.
+    // If the writer terminated while modifying an instance, its seqlock is left odd, with the value s_poisonedSeq:
+    // the instance is poisoned, and readers throw rather than spin, until the writer modifies it again.
+    // The state machines must be trivially copy constructible and destructible, and must not contain pointers.
+    //
+
+    namespace details {
+
+        inline constexpr char s_sharedPoolMagic[8] = { 'T', 'F', 'S', 'M', 'S', 'H', 'R', 'D' };
+
+        // the seqlock of a poisoned instance (odd, and never reached by counting, see SharedPoolStorage::endWrite)
+        inline constexpr uint32_t s_poisonedSeq = ~uint32_t(0);
+
+        template <typename FSM, typename StateId>
+        struct shared_pool_layout
+        {
+            using snapshot_t = snapshot_layout<FSM, StateId>;
+
+            static constexpr size_t s_seqOffset = sizeof(SnapshotHeader);
+
+            static constexpr size_t idsOffset(size_t capacity)
+            {
+                return s_seqOffset + capacity * sizeof(uint32_t);
+            }
+
+            static constexpr size_t machinesOffset(size_t capacity)
+            {
+                const size_t align = std::max<size_t>(64, alignof(FSM));
+                return (idsOffset(capacity) + capacity * sizeof(StateId) + align - 1) / align * align;
+            }
+
+            static constexpr size_t bytes(size_t capacity)
+            {
+                return machinesOffset(capacity) + capacity * sizeof(FSM);
+            }
+
+            static SnapshotHeader header(size_t capacity, size_t size)
+            {
+                SnapshotHeader h = snapshot_t::header(capacity, size);
+                std::memcpy(h.magic, s_sharedPoolMagic, sizeof(h.magic));
+                return h;
+            }
+
+            // throws std::runtime_error if the segment was not created for the same FSM
+            static void check(const SnapshotHeader& h, size_t segmentSize)
+            {
+                const SnapshotHeader expected = header(h.capacity, h.size);
+                if (std::memcmp(h.magic, expected.magic, sizeof(h.magic)) != 0)
+                    throw std::runtime_error("tiniest_fsm: not a shared StateMachinePool");
+                if (h.version != expected.version)
+                    throw std::runtime_error("tiniest_fsm: unsupported shared pool version");
+                if (h.statesHash != expected.statesHash || h.fsmSize != expected.fsmSize
+                    || h.fsmAlign != expected.fsmAlign || h.idSize != expected.idSize)
+                    throw std::runtime_error("tiniest_fsm: the shared pool was created by a different state machine");
+                if (h.size > h.capacity || segmentSize < bytes(h.capacity))
+                    throw std::runtime_error("tiniest_fsm: truncated shared pool");
+            }
+        };
+
+#if defined(_TINIEST_FSM_HAS_SHM)
+
+        // a mapping of a POSIX shared memory object
+        class shm_mapping
+        {
+            int m_fd = -1;
+            void* m_base = nullptr;
+            size_t m_bytes = 0;
+            bool m_created = false;
+
+            void release()
+            {
+                if (m_base)
+                    ::munmap(m_base, m_bytes);
+                if (m_fd >= 0)
+                    ::close(m_fd);
+                m_base = nullptr;
+                m_fd = -1;
+            }
+
+        public:
+
+            // releases the resources acquired so far and throws std::system_error
+            [[noreturn]] void fail(const char* what)
+            {
+                const int err = errno;
+                release();
+                throw std::system_error(err, std::generic_category(), what);
+            }
+
+            // Opens the shared memory object and maps it, for reading and writing if createSize is not 0,
+            // otherwise read only. If it does not exist, and createSize is not 0, it is created with createSize bytes.
+            shm_mapping(const char* name, size_t createSize)
+            {
+                const bool writable = createSize != 0;
+                m_fd = ::shm_open(name, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+                if (m_fd < 0)
+                    fail("tiniest_fsm: cannot open shared pool");
+                struct stat st;
+                if (::fstat(m_fd, &st) != 0)
+                    fail("tiniest_fsm: cannot stat shared pool");
+                m_created = writable && st.st_size == 0;
+                if (m_created) {
+                    m_bytes = createSize;
+                    if (::ftruncate(m_fd, off_t(m_bytes)) != 0)
+                        fail("tiniest_fsm: cannot resize shared pool");
+                }
+                else
+                    m_bytes = size_t(st.st_size);
+                if (m_bytes < sizeof(SnapshotHeader)) {
+                    release();
+                    throw std::runtime_error("tiniest_fsm: truncated shared pool");
+                }
+                m_base = ::mmap(nullptr, m_bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, m_fd, 0);
+                if (m_base == MAP_FAILED) {
+                    m_base = nullptr;
+                    fail("tiniest_fsm: cannot map shared pool");
+                }
+            }
+
+            shm_mapping(const shm_mapping&) = delete;
+            shm_mapping& operator=(const shm_mapping&) = delete;
+
+            ~shm_mapping()
+            {
+                release();
+            }
+
+            std::byte* base() const { return static_cast<std::byte*>(m_base); }
+            size_t bytes() const { return m_bytes; }
+
+            // true if the shared memory object was created by the constructor
+            bool created() const { return m_created; }
+
+            // checks the header with Layout::check, unmapping the segment if it throws
+            template <typename Layout>
+            void check()
+            {
+                try {
+                    Layout::check(*reinterpret_cast<const SnapshotHeader*>(base()), m_bytes);
+                }
+                catch (...) {
+                    release();
+                    throw;
+                }
+            }
+        };
+
+#endif // _TINIEST_FSM_HAS_SHM
+
+    } // namespace details
+
+#if defined(_TINIEST_FSM_HAS_SHM)
+
+    // Policy of StateMachinePool: the instances, their state ids and their seqlocks are stored in a POSIX shared
+    // memory object (e.g. "/sessions"), which other processes can read with SharedPoolReader. The pool is the writer:
+    //     StateMachinePool<Session, SharedPoolStorage> pool("/sessions", 100000);
+    // If the object exists, its instances are immediately available, otherwise an object with space for capacity
+    // instances is created. The object is not removed when the pool is destroyed, see remove.
+    // Only one process at a time must write to the pool.
+    // When reopening an object, the instances which the previous writer was modifying when it terminated are
+    // poisoned, and are listed by pool.storage().poisoned(). The writer should re-initialize each of them within
+    // a single modification, e.g.
+    //     for (size_t i : std::vector(pool.storage().poisoned().begin(), pool.storage().poisoned().end()))
+    //         pool.modify(i, [](Session& s) { s = Session{}; s.enterState<Idle>(); });
+    // at the end of which the instance is consistent again.
+    struct SharedPoolStorage
+    {
+        // removes the shared memory object, which is freed when all processes have unmapped it
+        static void remove(const char* name)
+        {
+            ::shm_unlink(name);
+        }
+
+        template <typename FSM, typename StateId>
+        class type
+        {
+            using layout = details::shared_pool_layout<FSM, StateId>;
+
+            details::shm_mapping m_segment;
+            std::vector<size_t> m_poisoned;
+
+            SnapshotHeader& header() const { return *reinterpret_cast<SnapshotHeader*>(m_segment.base()); }
+
+            std::atomic_ref<uint32_t> seq(size_t i) const
+            {
+                return std::atomic_ref<uint32_t>(reinterpret_cast<uint32_t*>(m_segment.base() + layout::s_seqOffset)[i]);
+            }
+
+        public:
+
+            type(const char* name, size_t capacity)
+                : m_segment(name, layout::bytes(capacity))
+            {
+                if (m_segment.created())
+                    header() = layout::header(capacity, 0);
+                else {
+                    m_segment.template check<layout>();
+                    // a writer may have terminated while modifying an instance, which stays odd until it is re-initialized
+                    for (size_t i = 0; i < this->capacity(); ++i)
+                        if (seq(i).load(std::memory_order_relaxed) & 1) {
+                            seq(i).store(details::s_poisonedSeq, std::memory_order_relaxed);
+                            m_poisoned.push_back(i);
+                        }
+                }
+            }
+
+            // the instances left inconsistent by the previous writer, which have not been modified since
+            std::span<const size_t> poisoned() const
+            {
+                return m_poisoned;
+            }
+
+            size_t size() const
+            {
+                return size_t(std::atomic_ref<uint64_t>(header().size).load(std::memory_order_relaxed));
+            }
+
+            size_t capacity() const { return size_t(header().capacity); }
+
+            void reserve(size_t n)
+            {
+                if (n > capacity())
+                    throw std::length_error("tiniest_fsm: the capacity of a shared pool cannot grow");
+            }
+
+            StateId* ids() const { return reinterpret_cast<StateId*>(m_segment.base() + layout::idsOffset(capacity())); }
+            FSM* machines() const { return std::launder(reinterpret_cast<FSM*>(m_segment.base() + layout::machinesOffset(capacity()))); }
+
+            template <typename...Args>
+            void emplace_back(Args&&...args)
+            {
+                const size_t n = size();
+                reserve(n + 1);
+                beginWrite(n);
+                ::new (static_cast<void*>(machines() + n)) FSM(std::forward<Args>(args)...);
+                storeId(n, StateId{});
+                endWrite(n);
+                // readers which see the new size see the new instance
+                std::atomic_ref<uint64_t>(header().size).store(n + 1, std::memory_order_release);
+            }
+
+            // the state id of instance i, which readers load concurrently, outside of the seqlock
+            void storeId(size_t i, StateId id)
+            {
+                std::atomic_ref<StateId>(ids()[i]).store(id, std::memory_order_release);
+            }
+
+            // the seqlock of instance i: odd while the instance is being modified, and while it is poisoned
+            void beginWrite(size_t i)
+            {
+                if (const uint32_t s = seq(i).load(std::memory_order_relaxed); s != details::s_poisonedSeq)
+                    seq(i).store(s + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+            }
+
+            // the count wraps to 0 before reaching s_poisonedSeq, and a poisoned instance restarts from 0
+            void endWrite(size_t i)
+            {
+                const uint32_t s = seq(i).load(std::memory_order_relaxed);
+                if (s == details::s_poisonedSeq) [[unlikely]]
+                    std::erase(m_poisoned, i);
+                seq(i).store(s == details::s_poisonedSeq || s + 1 == details::s_poisonedSeq - 1 ? 0 : s + 1, std::memory_order_release);
+            }
+        };
+    };
+
+    // A read only view, from any process, of a pool with SharedPoolStorage.
+    // Reading does not block the writer, and never makes system calls.
+    template <typename FSM>
+    class SharedPoolReader
+    {
+        using state_id_t = typename FSM::state_id_t;
+        using layout = details::shared_pool_layout<FSM, state_id_t>;
+
+        details::shm_mapping m_segment;
+        size_t m_capacity;
+
+        const SnapshotHeader& header() const { return *reinterpret_cast<const SnapshotHeader*>(m_segment.base()); }
+
+        // atomic_ref requires a non const object, but the segment is only read
+        template <typename T>
+        static std::atomic_ref<T> ref(const T& x) { return std::atomic_ref<T>(const_cast<T&>(x)); }
+
+        const uint32_t& seq(size_t i) const { return reinterpret_cast<const uint32_t*>(m_segment.base() + layout::s_seqOffset)[i]; }
+        const state_id_t* ids() const { return reinterpret_cast<const state_id_t*>(m_segment.base() + layout::idsOffset(m_capacity)); }
+        const std::byte* machine(size_t i) const { return m_segment.base() + layout::machinesOffset(m_capacity) + i * sizeof(FSM); }
+
+    public:
+
+        // maps the shared memory object created by the writer, throws if it does not exist or was created for another FSM
+        explicit SharedPoolReader(const char* name)
+            : m_segment(name, 0)
+        {
+            m_segment.template check<layout>();
+            m_capacity = size_t(header().capacity);
+        }
+
+        // number of instances in the pool
+        size_t size() const
+        {
+            return size_t(ref(header().size).load(std::memory_order_acquire));
+        }
+
+        // the current state id of the instance, as last written by the writer
+        // (the acquire load pairs with the release store of SharedPoolStorage::storeId)
+        unsigned currentStateId(size_t instance) const
+        {
+            return ref(ids()[instance]).load(std::memory_order_acquire);
+        }
+
+        // true if the writer terminated while modifying the instance, and it has not been re-initialized since
+        bool poisoned(size_t instance) const
+        {
+            return ref(seq(instance)).load(std::memory_order_relaxed) == details::s_poisonedSeq;
+        }
+
+        // A consistent copy of the instance: the state of the instance at some point between two modifications by the writer.
+        // Spins while the writer is modifying the instance. Throws std::runtime_error if the instance is poisoned.
+        FSM read(size_t instance) const
+        {
+            alignas(FSM) std::byte copy[sizeof(FSM)];
+            for (;;) {
+                const uint32_t before = ref(seq(instance)).load(std::memory_order_acquire);
+                if (before == details::s_poisonedSeq)
+                    throw std::runtime_error("tiniest_fsm: the instance was left inconsistent by a writer which terminated");
+                if ((before & 1) == 0) {
+                    std::memcpy(copy, machine(instance), sizeof(FSM));
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (ref(seq(instance)).load(std::memory_order_relaxed) == before)
+                        break;
+                }
+                details::cpu_relax();
+            }
+            return *std::launder(reinterpret_cast<const FSM*>(copy));
+        }
+    };
+
+#endif // _TINIEST_FSM_HAS_SHM
+
+} // namespace tiniest_fsm
+
+#undef _TINIEST_FSM_HAS_SHM
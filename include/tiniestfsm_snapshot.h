@@ -0,0 +1,255 @@
+#pragma once
+
+#include <tiniestfsm_pool.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define _TINIEST_FSM_HAS_MMAP
+#endif
+
+namespace tiniest_fsm {
+
+    // *****************************
+    // Snapshots of pools of state machines
+    //
+    // A snapshot is a flat binary file with the layout:
+    //     SnapshotHeader                  (64 bytes)
+    //     state_id_t ids[capacity]        (the packed array of state ids)
+    //     padding                         (up to a multiple of 64 bytes and of alignof(FSM))
+    //     FSM machines[capacity]          (the instances, copied byte by byte)
+    // of which only the first 'size' instances are in use. The file is in the native byte order.
+    // The state machines must not contain pointers, which would not be valid in another process.
+    //
+
+    struct SnapshotHeader
+    {
+        static constexpr char s_magic[8] = { 'T', 'F', 'S', 'M', 'P', 'O', 'O', 'L' };
+        static constexpr uint32_t s_version = 1;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t statesHash;  // details::type_hash of the std::tuple of states
+        uint32_t fsmSize;     // sizeof(FSM)
+        uint32_t fsmAlign;    // alignof(FSM)
+        uint32_t idSize;      // sizeof(state_id_t)
+        uint32_t reserved;
+        uint64_t capacity;    // number of instances for which there is space in the file
+        uint64_t size;        // number of instances in use
+        uint8_t padding[16];
+    };
+
+    static_assert(sizeof(SnapshotHeader) == 64);
+
+    namespace details {
+
+        template <typename FSM, typename StateId>
+        struct snapshot_layout
+        {
+            // instances are copied byte by byte into the array of machines, which is separate from the packed array of ids,
+            // and are never assigned, so only their copy construction and destruction need to be trivial
+            static_assert(std::is_trivially_copy_constructible_v<FSM> && std::is_trivially_destructible_v<FSM>,
+                "only pools of trivially copy constructible and destructible state machines can be saved to a snapshot");
+
+            static constexpr size_t s_idsOffset = sizeof(SnapshotHeader);
+
+            static constexpr size_t machinesOffset(size_t capacity)
+            {
+                const size_t align = std::max<size_t>(64, alignof(FSM));
+                return (s_idsOffset + capacity * sizeof(StateId) + align - 1) / align * align;
+            }
+
+            static constexpr size_t bytes(size_t capacity)
+            {
+                return machinesOffset(capacity) + capacity * sizeof(FSM);
+            }
+
+            static SnapshotHeader header(size_t capacity, size_t size)
+            {
+                SnapshotHeader h{};
+                std::memcpy(h.magic, SnapshotHeader::s_magic, sizeof(h.magic));
+                h.version = SnapshotHeader::s_version;
+                h.statesHash = type_hash<fsm_access::states_t<FSM>>();
+                h.fsmSize = uint32_t(sizeof(FSM));
+                h.fsmAlign = uint32_t(alignof(FSM));
+                h.idSize = uint32_t(sizeof(StateId));
+                h.capacity = capacity;
+                h.size = size;
+                return h;
+            }
+
+            // throws std::runtime_error if the snapshot was not written for the same FSM
+            static void check(const SnapshotHeader& h, size_t fileSize)
+            {
+                const SnapshotHeader expected = header(h.capacity, h.size);
+                if (std::memcmp(h.magic, expected.magic, sizeof(h.magic)) != 0)
+                    throw std::runtime_error("tiniest_fsm: not a snapshot of a StateMachinePool");
+                if (h.version != expected.version)
+                    throw std::runtime_error("tiniest_fsm: unsupported snapshot version");
+                if (h.statesHash != expected.statesHash || h.fsmSize != expected.fsmSize
+                    || h.fsmAlign != expected.fsmAlign || h.idSize != expected.idSize)
+                    throw std::runtime_error("tiniest_fsm: the snapshot was written by a different state machine");
+                if (h.size > h.capacity || fileSize < bytes(h.capacity))
+                    throw std::runtime_error("tiniest_fsm: truncated snapshot");
+            }
+        };
+
+    } // namespace details
+
+    // Writes all instances of the pool to a snapshot file, which can be mapped back with MappedPoolStorage.
+    // Throws std::runtime_error if the file cannot be written.
+    template <typename FSM, typename Storage>
+    void writeSnapshot(const StateMachinePool<FSM, Storage>& pool, const char* path)
+    {
+        using layout = details::snapshot_layout<FSM, typename FSM::state_id_t>;
+        const size_t n = pool.size();
+        const SnapshotHeader h = layout::header(n, n);
+        size_t padding = layout::machinesOffset(n) - layout::s_idsOffset - n * sizeof(typename FSM::state_id_t);
+        const char zeros[64] = {};
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(pool.stateIds().data()), std::streamsize(pool.stateIds().size_bytes()));
+        // the padding can be longer than zeros, with over-aligned state machines
+        for (; padding > 0; padding -= std::min(padding, sizeof(zeros)))
+            out.write(zeros, std::streamsize(std::min(padding, sizeof(zeros))));
+        out.write(reinterpret_cast<const char*>(pool.machines().data()), std::streamsize(pool.machines().size_bytes()));
+        out.flush();
+        // iostreams do not report the cause of the failure
+        if (!out)
+            throw std::runtime_error("tiniest_fsm: cannot write snapshot");
+    }
+
+#if defined(_TINIEST_FSM_HAS_MMAP)
+
+    // Policy of StateMachinePool: the instances and their state ids are stored in a memory mapped snapshot file.
+    // The pool is constructed with the path of the file and a capacity:
+    //     StateMachinePool<Door, MappedPoolStorage> pool("doors.snapshot", 1000000);
+    // If the file exists, the instances in the file are immediately available, without copying:
+    // pages are read from the file on first access. The capacity of an existing file cannot change.
+    // Otherwise, a file with space for capacity instances is created.
+    // Changes are written back to the file by the operating system, so they survive the termination
+    // of the process; pool.storage().flush() forces them to disk. A snapshot is consistent only if the process was not
+    // modifying the pool at the time it terminated.
+    struct MappedPoolStorage
+    {
+        template <typename FSM, typename StateId>
+        class type
+        {
+            using layout = details::snapshot_layout<FSM, StateId>;
+
+            int m_fd = -1;
+            void* m_base = nullptr;
+            size_t m_bytes = 0;
+
+            SnapshotHeader& header() const { return *static_cast<SnapshotHeader*>(m_base); }
+            std::byte* base() const { return static_cast<std::byte*>(m_base); }
+
+            void release()
+            {
+                if (m_base)
+                    ::munmap(m_base, m_bytes);
+                if (m_fd >= 0)
+                    ::close(m_fd);
+                m_base = nullptr;
+                m_fd = -1;
+            }
+
+            // releases the resources acquired so far and throws std::system_error, on the error paths of the constructor
+            [[noreturn]] void fail(const char* what)
+            {
+                const int err = errno;
+                release();
+                throw std::system_error(err, std::generic_category(), what);
+            }
+
+        public:
+
+            type(const char* path, size_t capacity)
+            {
+                m_fd = ::open(path, O_RDWR | O_CREAT, 0644);
+                if (m_fd < 0)
+                    fail("tiniest_fsm: cannot open snapshot");
+                struct stat st;
+                if (::fstat(m_fd, &st) != 0)
+                    fail("tiniest_fsm: cannot stat snapshot");
+                const bool create = st.st_size == 0;
+                if (create) {
+                    m_bytes = layout::bytes(capacity);
+                    if (::ftruncate(m_fd, off_t(m_bytes)) != 0)
+                        fail("tiniest_fsm: cannot resize snapshot");
+                }
+                else
+                    m_bytes = size_t(st.st_size);
+                m_base = ::mmap(nullptr, m_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+                if (m_base == MAP_FAILED) {
+                    m_base = nullptr;
+                    fail("tiniest_fsm: cannot map snapshot");
+                }
+                if (create)
+                    header() = layout::header(capacity, 0);
+                else {
+                    try {
+                        if (m_bytes < sizeof(SnapshotHeader))
+                            throw std::runtime_error("tiniest_fsm: truncated snapshot");
+                        layout::check(header(), m_bytes);
+                    }
+                    catch (...) {
+                        release();
+                        throw;
+                    }
+                }
+            }
+
+            type(const type&) = delete;
+            type& operator=(const type&) = delete;
+
+            ~type()
+            {
+                release();
+            }
+
+            size_t size() const { return size_t(header().size); }
+            size_t capacity() const { return size_t(header().capacity); }
+
+            void reserve(size_t n)
+            {
+                if (n > capacity())
+                    throw std::length_error("tiniest_fsm: the capacity of a mapped pool cannot grow");
+            }
+
+            StateId* ids() const { return reinterpret_cast<StateId*>(base() + layout::s_idsOffset); }
+            FSM* machines() const { return std::launder(reinterpret_cast<FSM*>(base() + layout::machinesOffset(capacity()))); }
+
+            template <typename...Args>
+            void emplace_back(Args&&...args)
+            {
+                const size_t n = size();
+                reserve(n + 1);
+                ::new (static_cast<void*>(machines() + n)) FSM(std::forward<Args>(args)...);
+                ids()[n] = StateId{};
+                header().size = n + 1;
+            }
+
+            // writes all changes to disk, throws std::system_error on failure (the file stays mapped)
+            void flush()
+            {
+                if (::msync(m_base, m_bytes, MS_SYNC) != 0)
+                    throw std::system_error(errno, std::generic_category(), "tiniest_fsm: cannot flush snapshot");
+            }
+        };
+    };
+
+#endif // _TINIEST_FSM_HAS_MMAP
+
+} // namespace tiniest_fsm
+
+#undef _TINIEST_FSM_HAS_MMAP
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <tiniestfsm.h>
+
+#include <vector>
+
+namespace tiniest_fsm {
+
+    // *****************************
+    // Timeouts of states
+    //
+
+    // The event delivered by TimerWheel when the timeout of a state expires
+    struct TimeoutEvent
+    {
+        unsigned state;  // the id of the state which armed the timeout, i.e. the current state
+    };
+
+    // A hierarchical timer wheel, for the option Timeouts of StateMachine.
+    // Time is measured in ticks, of any unit (e.g. milliseconds), and only moves forward, with advance.
+    // Timers are identified by dense ids (e.g. the ids of the instances of a StateMachinePool), and each id has at most
+    // one running timeout. Arming and cancelling a timer are O(1): each timer is a node of an intrusive list, in one of
+    // the 256 slots of one of 4 levels. Level L holds the timers which expire in less than 256^(L+1) ticks, and is
+    // cascaded into the lower levels every 256^L ticks. Timeouts longer than 2^32 ticks are cascaded more than once.
+    // Advancing the time skips the ticks at which no timer expires and no timer is cascaded, so its cost depends on the
+    // number of non-empty slots passed, rather than on the number of ticks.
+    class TimerWheel
+    {
+        // *****************************
+        // constants
+        //
+
+        static constexpr unsigned s_levels = 4;
+        static constexpr unsigned s_slotBits = 8;
+        static constexpr uint32_t s_slots = uint32_t(1) << s_slotBits;
+        static constexpr uint32_t s_nil = uint32_t(-1);
+
+        struct Node
+        {
+            uint64_t m_expiry;
+            uint32_t m_next;
+            uint32_t m_prev;
+            uint32_t m_slot;  // index in m_heads, or s_nil if the timer is not running
+            unsigned m_state;
+        };
+
+        // *****************************
+        // data members
+        //
+
+        uint64_t m_now;
+        size_t m_running = 0;
+        std::vector<Node> m_nodes;
+        std::array<uint32_t, s_levels * s_slots> m_heads;
+        std::vector<uint32_t> m_expired;  // the timers expired by advance, before delivery
+
+        // *****************************
+        // auxiliary functions
+        //
+
+        void link(uint32_t timer)
+        {
+            Node& n = m_nodes[timer];
+            const uint64_t delta = n.m_expiry - m_now;
+            unsigned level = 0;
+            while (level + 1 < s_levels && delta >= (uint64_t(1) << (s_slotBits * (level + 1))))
+                ++level;
+            n.m_slot = level * s_slots + uint32_t((n.m_expiry >> (s_slotBits * level)) & (s_slots - 1));
+            n.m_prev = s_nil;
+            n.m_next = m_heads[n.m_slot];
+            if (n.m_next != s_nil)
+                m_nodes[n.m_next].m_prev = timer;
+            m_heads[n.m_slot] = timer;
+        }
+
+        void unlink(uint32_t timer)
+        {
+            Node& n = m_nodes[timer];
+            if (n.m_prev != s_nil)
+                m_nodes[n.m_prev].m_next = n.m_next;
+            else
+                m_heads[n.m_slot] = n.m_next;
+            if (n.m_next != s_nil)
+                m_nodes[n.m_next].m_prev = n.m_prev;
+            n.m_slot = s_nil;
+        }
+
+        // detaches the list of timers in the slot, and returns its first node
+        uint32_t take(uint32_t slot)
+        {
+            const uint32_t head = m_heads[slot];
+            m_heads[slot] = s_nil;
+            return head;
+        }
+
+        // moves the timers of the slot of level L at the current time into the lower levels
+        void cascade(unsigned level)
+        {
+            const uint32_t slot = level * s_slots + uint32_t((m_now >> (s_slotBits * level)) & (s_slots - 1));
+            for (uint32_t t = take(slot); t != s_nil;) {
+                const uint32_t next = m_nodes[t].m_next;
+                link(t);
+                t = next;
+            }
+        }
+
+        // The first tick after the current time at which a non-empty slot is reached, i.e. either timers expire
+        // (level 0) or timers are cascaded (the other levels), or uint64_t(-1) if all slots are empty.
+        // Level L is reached every 256^L ticks, so the levels above the first one found need not be scanned
+        // if their next cascade is later.
+        uint64_t nextTick() const
+        {
+            uint64_t next = uint64_t(-1);
+            for (unsigned level = 0; level < s_levels; ++level) {
+                const unsigned shift = s_slotBits * level;
+                const uint64_t base = m_now >> shift;
+                if (((base + 1) << shift) >= next)
+                    break;
+                // the slots of the level in the order in which they are reached, including the current one after a full turn
+                for (uint64_t k = 1; k <= s_slots; ++k) {
+                    if (m_heads[level * s_slots + uint32_t((base + k) & (s_slots - 1))] != s_nil) {
+                        next = std::min(next, (base + k) << shift);
+                        break;
+                    }
+                }
+            }
+            return next;
+        }
+
+        // moves the time forward by one tick, and appends the timers which expire to m_expired
+        void tick()
+        {
+            ++m_now;
+            for (unsigned level = 1; level < s_levels; ++level) {
+                if ((m_now & ((uint64_t(1) << (s_slotBits * level)) - 1)) != 0)
+                    break;
+                cascade(level);
+            }
+            for (uint32_t t = take(uint32_t(m_now & (s_slots - 1))); t != s_nil; t = m_nodes[t].m_next) {
+                m_nodes[t].m_slot = s_nil;
+                m_expired.push_back(t);
+            }
+        }
+
+    public:
+
+        // a wheel whose current time is now
+        explicit TimerWheel(uint64_t now = 0)
+            : m_now(now)
+        {
+            m_heads.fill(s_nil);
+        }
+
+        TimerWheel(const TimerWheel&) = delete;
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+        // the current time, in ticks
+        uint64_t now() const { return m_now; }
+
+        // the number of running timers
+        size_t size() const { return m_running; }
+
+        // allocates the nodes for the timers with ids in [0, n)
+        void reserve(size_t n)
+        {
+            if (n > m_nodes.size())
+                m_nodes.resize(n, Node{ 0, s_nil, s_nil, s_nil, 0 });
+        }
+
+        // true if the timer is running
+        bool running(uint32_t timer) const
+        {
+            return timer < m_nodes.size() && m_nodes[timer].m_slot != s_nil;
+        }
+
+        // (Re)starts the timer, to expire after the given number of ticks (at least one),
+        // with a TimeoutEvent for the given state
+        void arm(uint32_t timer, uint64_t ticks, unsigned state)
+        {
+            reserve(size_t(timer) + 1);
+            cancel(timer);
+            Node& n = m_nodes[timer];
+            n.m_expiry = m_now + std::max<uint64_t>(ticks, 1);
+            n.m_state = state;
+            link(timer);
+            ++m_running;
+        }
+
+        // stops the timer, if it is running
+        void cancel(uint32_t timer)
+        {
+            if (running(timer)) {
+                unlink(timer);
+                --m_running;
+            }
+        }
+
+        // Moves the current time forward to now, and then invokes f(uint32_t timer, const TimeoutEvent&) for each
+        // timer which expired, in order of expiry. Returns the number of expired timers.
+        // The expired timers are collected first, so f can arm and cancel any timer, e.g. by entering new states.
+        template <typename F>
+        size_t advance(uint64_t now, F&& f)
+        {
+            while (m_now < now && m_running > m_expired.size()) {
+                // no timer expires nor is cascaded before next
+                const uint64_t next = nextTick();
+                if (next > now)
+                    break;
+                m_now = next - 1;
+                tick();
+            }
+            m_now = std::max(m_now, now);
+            m_running -= m_expired.size();
+            std::vector<uint32_t> expired;
+            expired.swap(m_expired);
+            for (const uint32_t t : expired)
+                f(t, TimeoutEvent{ m_nodes[t].m_state });
+            const size_t n = expired.size();
+            expired.clear();
+            if (m_expired.empty())
+                m_expired.swap(expired);  // keeps the capacity, unless f called advance
+            return n;
+        }
+
+        // Moves the current time forward to now, and delivers a TimeoutEvent to each instance of the pool whose timer
+        // expired, where the timer of each instance is its id in the pool (see attachTimers).
+        // Returns the number of expired timers.
+        template <typename Pool>
+        size_t expire(uint64_t now, Pool& pool)
+        {
+            return advance(now, [&](uint32_t timer, const TimeoutEvent& ev) { pool.process(timer, ev); });
+        }
+    };
+
+    // Attaches all instances of the pool to the wheel, each with its id in the pool as timer id,
+    // and arms the timeouts of their current states
+    template <typename Pool>
+    void attachTimers(Pool& pool, TimerWheel& wheel)
+    {
+        wheel.reserve(pool.size());
+        for (size_t i = 0; i < pool.size(); ++i)
+            pool.modify(i, [&](auto& fsm) { fsm.attachTimer(wheel, uint32_t(i)); });
+    }
+
+} // namespace tiniest_fsm
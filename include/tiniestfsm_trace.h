@@ -0,0 +1,341 @@
+#pragma once
+
+#include <tiniestfsm.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <ostream>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace tiniest_fsm {
+
+    namespace details {
+
+        // a cheap monotonic timestamp: the time stamp counter where available, otherwise nanoseconds
+        inline uint64_t timestamp()
+        {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#elif defined(__aarch64__)
+            uint64_t t;
+            asm volatile("mrs %0, cntvct_el0" : "=r"(t));
+            return t;
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+
+    } // namespace details
+
+    enum class TraceKind : uint8_t
+    {
+        Event,      // state is about to handle the event
+        Unhandled,  // state has no handler for the event
+        Enter       // the state machine is changing from state 'state' to state 'target'
+    };
+
+    struct TraceRecord
+    {
+        uint64_t timestamp;  // see details::timestamp
+        uint32_t eventType;  // details::type_hash<Event>(), or 0 for TraceKind::Enter
+        uint16_t state;      // id of the current state
+        uint16_t target;     // id of the new state for TraceKind::Enter, or 0
+        TraceKind kind;
+    };
+
+    // A tracer which records events and transitions in a circular buffer of Capacity records,
+    // overwriting the oldest records when full.
+    // Recording is wait-free. The records can be read by another thread via snapshot.
+    // To identify event types offline, compare TraceRecord::eventType with details::type_hash<Event>().
+    template <size_t Capacity>
+    class RingBufferTracer
+    {
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+        static constexpr size_t s_words = (sizeof(TraceRecord) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        static constexpr uint64_t s_writing = uint64_t(-1);
+
+        // a record, stored in atomic words, stamped with 1 + its position in the sequence of all records,
+        // or s_writing while it is being written: a reader which reads the same stamp before and after
+        // the words of the record has read a record which was not overwritten meanwhile
+        struct Slot
+        {
+            std::atomic<uint64_t> m_seq{ 0 };
+            std::array<std::atomic<uint64_t>, s_words> m_words{};
+        };
+
+        std::array<Slot, Capacity> m_slots;
+        std::atomic<uint64_t> m_head{ 0 };  // number of records ever written
+
+        void record(TraceKind kind, uint32_t eventType, unsigned state, unsigned target)
+        {
+            const TraceRecord r{ details::timestamp(), eventType, uint16_t(state), uint16_t(target), kind };
+            std::array<uint64_t, s_words> words{};
+            std::memcpy(words.data(), &r, sizeof(r));
+            const uint64_t head = m_head.load(std::memory_order_relaxed);
+            Slot& slot = m_slots[head & (Capacity - 1)];
+            slot.m_seq.store(s_writing, std::memory_order_relaxed);
+            // the release stores keep the store of s_writing before the new words, for a reader which sees them
+            for (size_t w = 0; w < s_words; ++w)
+                slot.m_words[w].store(words[w], std::memory_order_release);
+            slot.m_seq.store(head + 1, std::memory_order_release);
+            m_head.store(head + 1, std::memory_order_release);
+        }
+
+        // copies the record at position i of the sequence into out, unless it was overwritten
+        bool read(uint64_t i, TraceRecord& out) const
+        {
+            const Slot& slot = m_slots[i & (Capacity - 1)];
+            if (slot.m_seq.load(std::memory_order_acquire) != i + 1)
+                return false;
+            std::array<uint64_t, s_words> words;
+            for (size_t w = 0; w < s_words; ++w)
+                words[w] = slot.m_words[w].load(std::memory_order_acquire);
+            if (slot.m_seq.load(std::memory_order_relaxed) != i + 1)
+                return false;
+            std::memcpy(&out, words.data(), sizeof(out));
+            return true;
+        }
+
+    public:
+
+        template <typename State, typename FSM, typename Event>
+        void onEvent(const FSM&, const Event&)
+        {
+            record(TraceKind::Event, details::type_hash<Event>(), FSM::template stateIndex<State>(), 0);
+        }
+
+        template <typename State, typename FSM, typename Event>
+        void onUnhandled(const FSM&, const Event&)
+        {
+            record(TraceKind::Unhandled, details::type_hash<Event>(), FSM::template stateIndex<State>(), 0);
+        }
+
+        template <typename To, typename FSM>
+        void onEnter(const FSM&, unsigned from)
+        {
+            record(TraceKind::Enter, 0, from, FSM::template stateIndex<To>());
+        }
+
+        // number of records ever written
+        uint64_t count() const
+        {
+            return m_head.load(std::memory_order_acquire);
+        }
+
+        // Copies into out the most recent records, oldest first, and returns the number of records copied.
+        // Records which were overwritten by the writer during the copy are discarded, with all those before
+        // them, so that the records copied are consecutive.
+        size_t snapshot(std::span<TraceRecord> out) const
+        {
+            const uint64_t head = m_head.load(std::memory_order_acquire);
+            const uint64_t n = std::min<uint64_t>({ head, Capacity, out.size() });
+            size_t copied = 0;
+            for (uint64_t i = head - n; i < head; ++i)
+                copied = read(i, out[copied]) ? copied + 1 : 0;
+            return copied;
+        }
+    };
+
+    // A histogram of non negative integer values (e.g. durations in ticks of details::timestamp) with
+    // logarithmic buckets, each split into 2^SubBucketBits linear sub-buckets, so that the relative error
+    // of the reported values is at most 2^-SubBucketBits. Recording is allocation free.
+    template <unsigned SubBucketBits = 3>
+    class LatencyHistogram
+    {
+        static constexpr unsigned s_nSub = 1u << SubBucketBits;
+        static constexpr size_t s_nBuckets = (64 - SubBucketBits + 1) * s_nSub;
+
+        std::array<uint64_t, s_nBuckets> m_counts{};
+        uint64_t m_count = 0;
+        uint64_t m_max = 0;
+
+        static size_t bucketOf(uint64_t v)
+        {
+            if (v < s_nSub)
+                return size_t(v);
+            const unsigned e = unsigned(std::bit_width(v)) - 1 - SubBucketBits;
+            return size_t(e + 1) * s_nSub + size_t((v >> e) & (s_nSub - 1));
+        }
+
+        // the largest value which falls in bucket b
+        static uint64_t upperBound(size_t b)
+        {
+            if (b < s_nSub)
+                return b;
+            const unsigned e = unsigned(b / s_nSub) - 1;
+            const uint64_t lower = (uint64_t(s_nSub) | (b % s_nSub)) << e;
+            return lower + ((uint64_t(1) << e) - 1);
+        }
+
+    public:
+
+        void record(uint64_t v)
+        {
+            ++m_counts[bucketOf(v)];
+            ++m_count;
+            m_max = std::max(m_max, v);
+        }
+
+        uint64_t count() const { return m_count; }
+        uint64_t max() const { return m_max; }
+
+        // returns an upper bound of the p-th percentile (with p in [0, 100]), or 0 if the histogram is empty
+        uint64_t percentile(double p) const
+        {
+            const uint64_t rank = uint64_t(p / 100.0 * double(m_count) + 0.5);
+            uint64_t seen = 0;
+            for (size_t b = 0; b < s_nBuckets; ++b) {
+                seen += m_counts[b];
+                if (seen >= rank && seen > 0)
+                    return std::min(upperBound(b), m_max);
+            }
+            return m_max;
+        }
+
+        void reset()
+        {
+            *this = LatencyHistogram{};
+        }
+    };
+
+    // A tracer which measures, in ticks of details::timestamp, the duration of each handler invocation,
+    // by (state, event), and the duration of each transition (including the call to enter), by target state.
+    // The histograms are thread local and allocation free: each is registered in a thread local list
+    // the first time it is used, and can then be visited, on the same thread, with forEach or dump.
+    // Note that the duration of a handler includes the duration of the transitions it triggers.
+    class LatencyHistogramTracer
+    {
+    public:
+
+        using histogram_t = LatencyHistogram<>;
+
+        struct Entry
+        {
+            std::string_view fsm;
+            std::string_view state;
+            unsigned stateIndex;
+            std::string_view event;  // empty for the histogram of the transitions into state
+            histogram_t histogram;
+            Entry* next;
+
+            Entry(std::string_view fsm_, std::string_view state_, unsigned stateIndex_, std::string_view event_)
+                : fsm(fsm_), state(state_), stateIndex(stateIndex_), event(event_), next(head())
+            {
+                head() = this;
+            }
+        };
+
+    private:
+
+        static Entry*& head()
+        {
+            thread_local Entry* h = nullptr;
+            return h;
+        }
+
+        // the histogram of Event handled in State, or of the transitions into State if Event is void
+        template <typename FSM, typename State, typename Event>
+        static histogram_t& histogram()
+        {
+            constexpr std::string_view eventName = [] {
+                if constexpr (std::is_void_v<Event>)
+                    return std::string_view{};
+                else
+                    return details::type_name<Event>();
+            }();
+            thread_local Entry entry(details::type_name<FSM>(), details::type_name<State>(), FSM::template stateIndex<State>(), eventName);
+            return entry.histogram;
+        }
+
+    public:
+
+        template <typename State, typename FSM, typename Event>
+        uint64_t onEvent(const FSM&, const Event&)
+        {
+            return details::timestamp();
+        }
+
+        template <typename State, typename FSM, typename Event>
+        void onHandled(const FSM&, const Event&, uint64_t start)
+        {
+            histogram<FSM, State, Event>().record(details::timestamp() - start);
+        }
+
+        template <typename To, typename FSM>
+        uint64_t onEnter(const FSM&, unsigned)
+        {
+            return details::timestamp();
+        }
+
+        template <typename To, typename FSM>
+        void onEntered(const FSM&, uint64_t start)
+        {
+            histogram<FSM, To, void>().record(details::timestamp() - start);
+        }
+
+        // invokes f(const Entry&) for each histogram used so far by the calling thread
+        template <typename F>
+        static void forEach(F&& f)
+        {
+            for (const Entry* e = head(); e; e = e->next)
+                f(*e);
+        }
+
+        // resets all histograms of the calling thread
+        static void reset()
+        {
+            for (Entry* e = head(); e; e = e->next)
+                e->histogram.reset();
+        }
+
+        // prints a summary of all histograms of the calling thread
+        static void dump(std::ostream& os)
+        {
+            forEach([&](const Entry& e) {
+                os << e.fsm << ' ' << e.state << " (" << e.stateIndex << ") ";
+                if (e.event.empty())
+                    os << "enter";
+                else
+                    os << e.event;
+                os << ": count=" << e.histogram.count()
+                   << " p50=" << e.histogram.percentile(50)
+                   << " p99=" << e.histogram.percentile(99)
+                   << " p99.9=" << e.histogram.percentile(99.9)
+                   << " max=" << e.histogram.max() << '\n';
+            });
+        }
+
+        // Prints the option HotStates with the (up to) n states of FSM which handled most events on the calling thread,
+        // e.g. "tiniest_fsm::HotStates<Idle, Active>", to be pasted in the declaration of FSM
+        template <typename FSM>
+        static void dumpHotStates(std::ostream& os, size_t n = 4)
+        {
+            std::vector<std::pair<std::string_view, uint64_t>> counts;
+            forEach([&](const Entry& e) {
+                if (e.fsm != details::type_name<FSM>() || e.event.empty())
+                    return;
+                auto it = std::find_if(counts.begin(), counts.end(), [&](const auto& c) { return c.first == e.state; });
+                if (it == counts.end())
+                    counts.emplace_back(e.state, e.histogram.count());
+                else
+                    it->second += e.histogram.count();
+            });
+            std::stable_sort(counts.begin(), counts.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+            os << "tiniest_fsm::HotStates<";
+            for (size_t i = 0; i < std::min(n, counts.size()) && counts[i].second > 0; ++i)
+                os << (i ? ", " : "") << counts[i].first;
+            os << ">\n";
+        }
+    };
+
+} // namespace tiniest_fsm